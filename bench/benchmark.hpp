@@ -0,0 +1,50 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+/**
+ * @brief a tiny microbenchmark harness, every benchmark reports the average time of one operation in nanoseconds
+ */
+namespace benchmark {
+
+using Clock = std::chrono::steady_clock;
+
+// keeps the compiler from optimizing away a value that is computed but never used
+template <typename T> inline void do_not_optimize(const T &value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+// set from the command line, only benchmarks whose name contains it are run
+inline std::string filter;
+
+inline bool should_run(const std::string &name) { return filter.empty() or name.find(filter) != std::string::npos; }
+
+inline void report(const std::string &name, double ns_per_op, size_t num_ops) {
+    std::cout << std::left << std::setw(64) << name << std::right << std::setw(12) << std::fixed
+              << std::setprecision(1) << ns_per_op << " ns/op" << std::setw(12) << num_ops << " ops" << std::endl;
+}
+
+/**
+ * @brief runs op a few times to warm up caches and then times num_ops calls of it
+ */
+template <typename Op> void run(const std::string &name, size_t num_ops, Op &&op) {
+    if (not should_run(name))
+        return;
+
+    for (size_t i = 0; i < num_ops / 10 + 1; i++)
+        op();
+
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < num_ops; i++)
+        op();
+    Clock::time_point end = Clock::now();
+
+    report(name, std::chrono::duration<double, std::nano>(end - start).count() / num_ops, num_ops);
+}
+
+} // namespace benchmark
+
+#endif // BENCHMARK_HPP
@@ -0,0 +1,534 @@
+#include "benchmark.hpp"
+
+#include "chord_system.hpp"
+#include "injection_socket.hpp"
+#include "input_source.hpp"
+#include "key_interceptor.hpp"
+#include "output_sink.hpp"
+#include "simultaneous_keypresses.hpp"
+
+#include "utility/logger/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <linux/input.h>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief a chord system whose "keyboard" is a pipe that the benchmarks fill with synthetic evdev events and whose
+ * virtual keyboard is /dev/null, so everything up to the write syscall is measured without any real devices
+ */
+struct NullPipeline {
+    int pipe_file_descriptors[2];
+    int null_file_descriptor;
+    std::unique_ptr<ChordSystem> chord_system;
+
+    NullPipeline() {
+        if (pipe2(pipe_file_descriptors, O_NONBLOCK) < 0) {
+            throw std::runtime_error("Failed to create the synthetic input pipe");
+        }
+
+        null_file_descriptor = open("/dev/null", O_WRONLY);
+        if (null_file_descriptor < 0) {
+            throw std::runtime_error("Failed to open /dev/null");
+        }
+
+        // NOTE: opening the /proc path of the read end gives the adapter its own descriptor for the same pipe
+        std::string device_path = "/proc/self/fd/" + std::to_string(pipe_file_descriptors[0]);
+        chord_system = std::make_unique<ChordSystem>(device_path, null_file_descriptor, false);
+    }
+
+    ~NullPipeline() {
+        chord_system.reset();
+        close(pipe_file_descriptors[0]);
+        close(pipe_file_descriptors[1]);
+        close(null_file_descriptor);
+    }
+
+    KeyInterceptor &key_interceptor() { return chord_system->key_interceptor; }
+
+    void write_events(const std::vector<input_event> &events) {
+        write(pipe_file_descriptors[1], events.data(), events.size() * sizeof(input_event));
+    }
+
+    // ends one simulated tick the same way KeyInterceptor::update does
+    void end_tick() {
+        key_interceptor().keys_to_ignore_this_update.clear();
+        key_interceptor().linux_input_adapter.key_bitmap_state.process();
+        key_interceptor().input_state.process();
+        key_interceptor().virtual_input_state.process();
+    }
+
+    void set_pressed(EKey key, bool pressed) {
+        key_interceptor().input_state.key_enum_to_object.at(key)->pressed_signal.set(pressed);
+    }
+};
+
+// keys that have a linux code, so they can be used as both the input and the output of synthetic mappings
+std::vector<EKey> get_forwardable_keys(KeyInterceptor &key_interceptor) {
+    std::vector<EKey> keys;
+    for (const auto &[key_enum, linux_code] : key_interceptor.key_enum_to_linux_code) {
+        if (key_enum == EKey::SPACE)
+            continue;
+        keys.push_back(key_enum);
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+input_event make_event(int type, int code, int value) {
+    input_event ev{};
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    return ev;
+}
+
+void bench_evdev_decode(NullPipeline &pipeline) {
+    LinuxInputAdapter &adapter = pipeline.key_interceptor().linux_input_adapter;
+
+    std::vector<int> key_codes;
+    for (const auto &[linux_code, key_enum] : adapter.linux_code_to_key_enum)
+        key_codes.push_back(linux_code);
+    std::sort(key_codes.begin(), key_codes.end());
+
+    std::vector<input_event> key_batch;
+    for (size_t i = 0; key_batch.size() < 256; i++) {
+        int code = key_codes[i % key_codes.size()];
+        key_batch.push_back(make_event(EV_KEY, code, LinuxInputAdapter::press_value));
+        key_batch.push_back(make_event(EV_SYN, SYN_REPORT, 0));
+        key_batch.push_back(make_event(EV_KEY, code, LinuxInputAdapter::release_value));
+        key_batch.push_back(make_event(EV_SYN, SYN_REPORT, 0));
+    }
+
+    // what a 1000hz mouse produces, one frame per report
+    std::vector<input_event> mouse_batch;
+    while (mouse_batch.size() + 3 <= 256) {
+        mouse_batch.push_back(make_event(EV_REL, REL_X, 1));
+        mouse_batch.push_back(make_event(EV_REL, REL_Y, -1));
+        mouse_batch.push_back(make_event(EV_SYN, SYN_REPORT, 0));
+    }
+
+    struct NamedBatch {
+        std::string name;
+        std::vector<input_event> batch;
+        // events are 10ms apart so none of them is a bounce, this is what the debounce costs keys that don't chatter
+        bool debounced = false;
+    };
+    std::vector<NamedBatch> named_batches = {
+        {"poll_events/evdev_decode/keys (per event)", key_batch},
+        {"poll_events/evdev_decode/keys/debounced:5ms (per event)", key_batch, true},
+        {"poll_events/evdev_decode/mouse (per event)", mouse_batch},
+    };
+
+    for (auto &[name, batch, debounced] : named_batches) {
+        if (not benchmark::should_run(name))
+            continue;
+
+        adapter.debounce.set_window(std::chrono::milliseconds(debounced ? 5 : 0));
+        const size_t num_rounds = 4000;
+        double total_ns = 0;
+        for (size_t round = 0; round < num_rounds; round++) {
+            if (debounced) {
+                for (size_t i = 0; i < batch.size(); i++) {
+                    int64_t time_ms = 10 * static_cast<int64_t>(round * batch.size() + i);
+                    batch[i].input_event_sec = time_ms / 1000;
+                    batch[i].input_event_usec = (time_ms % 1000) * 1000;
+                }
+            }
+            pipeline.write_events(batch);
+
+            // only the read and decode are timed, not filling the pipe
+            benchmark::Clock::time_point start = benchmark::Clock::now();
+            adapter.poll_events();
+            benchmark::Clock::time_point end = benchmark::Clock::now();
+            total_ns += std::chrono::duration<double, std::nano>(end - start).count();
+
+            benchmark::do_not_optimize(adapter.take_relative_motion());
+        }
+
+        benchmark::report(name, total_ns / (num_rounds * batch.size()), num_rounds * batch.size());
+    }
+    adapter.debounce.set_window(std::chrono::microseconds(0));
+
+    // leave every key released for the benchmarks that follow
+    for (const auto &[linux_code, key_enum] : adapter.linux_code_to_key_enum)
+        pipeline.set_pressed(key_enum, false);
+    pipeline.end_tick();
+    pipeline.end_tick();
+}
+
+void bench_translation(NullPipeline &pipeline) {
+    KeyInterceptor &key_interceptor = pipeline.key_interceptor();
+    LinuxInputAdapter &adapter = key_interceptor.linux_input_adapter;
+
+    std::vector<int> key_codes;
+    for (const auto &[linux_code, key_enum] : adapter.linux_code_to_key_enum)
+        key_codes.push_back(linux_code);
+
+    std::vector<EKey> keys = get_forwardable_keys(key_interceptor);
+
+    size_t i = 0;
+    benchmark::run("translation/linux_code_to_key_enum", 10'000'000, [&]() {
+        auto it = adapter.linux_code_to_key_enum.find(key_codes[i++ % key_codes.size()]);
+        benchmark::do_not_optimize(it->second);
+    });
+
+    i = 0;
+    benchmark::run("translation/key_enum_to_linux_code", 10'000'000, [&]() {
+        benchmark::do_not_optimize(key_interceptor.key_enum_to_linux_code.at(keys[i++ % keys.size()]));
+    });
+}
+
+void bench_send_key(NullPipeline &pipeline) {
+    KeyInterceptor &key_interceptor = pipeline.key_interceptor();
+
+    int value = LinuxInputAdapter::press_value;
+    benchmark::run("send_key_to_virtual_keyboard/null_sink", 1'000'000, [&]() {
+        key_interceptor.send_key_to_virtual_keyboard(EKey::a, value);
+        key_interceptor.input_output_backend->flush();
+        value = value == LinuxInputAdapter::press_value ? LinuxInputAdapter::release_value
+                                                        : LinuxInputAdapter::press_value;
+    });
+
+    // keys that need shift held are sent as four events instead of two
+    value = LinuxInputAdapter::press_value;
+    benchmark::run("send_key_to_virtual_keyboard/null_sink/shifted", 1'000'000, [&]() {
+        key_interceptor.send_key_to_virtual_keyboard(EKey::EXCLAMATION_POINT, value);
+        key_interceptor.input_output_backend->flush();
+        value = value == LinuxInputAdapter::press_value ? LinuxInputAdapter::release_value
+                                                        : LinuxInputAdapter::press_value;
+    });
+
+    pipeline.end_tick();
+}
+
+// simulates typing: every key is pressed on one tick and released on the next
+template <typename Logic> void run_typing_benchmark(NullPipeline &pipeline, const std::string &name, size_t num_ops,
+                                                    const std::vector<EKey> &keys, Logic &&logic) {
+    size_t tick = 0;
+    benchmark::run(name, num_ops, [&]() {
+        EKey key = keys[(tick / 2) % keys.size()];
+        pipeline.set_pressed(key, tick % 2 == 0);
+        logic();
+        pipeline.end_tick();
+        tick++;
+    });
+
+    for (EKey key : keys)
+        pipeline.set_pressed(key, false);
+    pipeline.end_tick();
+    pipeline.end_tick();
+}
+
+// the per tick work of finding which keys changed, through the Key objects of InputState and through a KeyBitmapState
+void bench_key_diffing(NullPipeline &pipeline) {
+    std::vector<EKey> keys = get_forwardable_keys(pipeline.key_interceptor());
+    const auto &linux_code_to_key_enum = pipeline.key_interceptor().linux_input_adapter.linux_code_to_key_enum;
+
+    // a few keys held down, as while typing
+    for (size_t i = 0; i < 4; i++)
+        pipeline.set_pressed(keys[i], true);
+    pipeline.end_tick();
+
+    InputState &input_state = pipeline.key_interceptor().input_state;
+    benchmark::run("key_diffing/InputState::get_just_pressed/held/released_keys", 1'000'000, [&]() {
+        benchmark::do_not_optimize(input_state.get_just_pressed_keys());
+        benchmark::do_not_optimize(input_state.get_held_keys());
+        benchmark::do_not_optimize(input_state.get_just_released_keys());
+        input_state.process();
+    });
+
+    KeyBitmapState key_bitmap_state;
+    for (const auto &[linux_code, key_enum] : linux_code_to_key_enum)
+        key_bitmap_state.current.set(linux_code, input_state.is_pressed(key_enum));
+    key_bitmap_state.process();
+
+    benchmark::run("key_diffing/KeyBitmapState::get_just_pressed/held/released", 1'000'000, [&]() {
+        int num_keys = 0;
+        auto count = [&](int) { num_keys++; };
+        key_bitmap_state.get_just_pressed().for_each_set_key(count);
+        key_bitmap_state.get_held().for_each_set_key(count);
+        key_bitmap_state.get_just_released().for_each_set_key(count);
+        key_bitmap_state.process();
+        benchmark::do_not_optimize(num_keys);
+    });
+
+    for (size_t i = 0; i < 4; i++)
+        pipeline.set_pressed(keys[i], false);
+    pipeline.end_tick();
+    pipeline.end_tick();
+}
+
+void bench_simultaneous_keypresses(NullPipeline &pipeline) {
+    SimultaneousKeypresses &simultaneous_keypresses = pipeline.chord_system->simultaneous_keypresses;
+    std::vector<EKey> keys = get_forwardable_keys(pipeline.key_interceptor());
+
+    run_typing_benchmark(pipeline, "InputState::process (baseline for the tick benchmarks)", 1'000'000, keys, []() {});
+
+    std::vector<SimultaneousKeypresses::Combo> original_combos = simultaneous_keypresses.combos;
+
+    int num_combos_fired = 0;
+    for (size_t num_combos : {2, 20, 200}) {
+        simultaneous_keypresses.combos.clear();
+        for (size_t i = 0; i < num_combos; i++) {
+            EKey key1 = keys[i % keys.size()];
+            EKey key2 = keys[(i * 7 + 1) % keys.size()];
+            simultaneous_keypresses.register_combo(key1, key2);
+        }
+
+        run_typing_benchmark(pipeline, "SimultaneousKeypresses::process/combos:" + std::to_string(num_combos),
+                             2'000'000 / num_combos, keys,
+                             [&]() { simultaneous_keypresses.process([&](size_t) { num_combos_fired++; }); });
+    }
+    benchmark::do_not_optimize(num_combos_fired);
+
+    simultaneous_keypresses.combos = original_combos;
+}
+
+void bench_per_iteration_logic(NullPipeline &pipeline) {
+    ChordSystem &chord_system = *pipeline.chord_system;
+    std::vector<EKey> keys = get_forwardable_keys(pipeline.key_interceptor());
+
+    run_typing_benchmark(pipeline, "ChordSystem::per_iteration_logic/not_mapping", 500'000, keys,
+                         [&]() { chord_system.per_iteration_logic(); });
+
+    // the layer is held active the whole time so every synthetic mapping is live, the combos are removed so the
+    // synthetic keys can't switch to another layer
+    std::vector<SimultaneousKeypresses::Combo> original_combos = chord_system.simultaneous_keypresses.combos;
+    chord_system.simultaneous_keypresses.combos.clear();
+
+    auto &layer = chord_system.get_key_map(ChordSystem::MapName::homesick);
+    std::span<const static_layers::KeyMapping> original_mappings = layer.key_mappings;
+    std::vector<static_layers::KeyMapping> synthetic_mappings;
+
+    pipeline.set_pressed(EKey::SPACE, true);
+    pipeline.end_tick();
+
+    for (size_t num_mappings : {10, 100, 1000}) {
+        synthetic_mappings.clear();
+        for (size_t i = 0; i < num_mappings; i++) {
+            synthetic_mappings.push_back({keys[i % keys.size()], keys[(i + 1) % keys.size()]});
+        }
+        layer.set_key_mappings(synthetic_mappings);
+
+        chord_system.current_mapping = ChordSystem::MapName::homesick;
+        chord_system.key_used_to_start_mapping = EKey::SPACE;
+        chord_system.mapping_mode_active = true;
+
+        run_typing_benchmark(pipeline, "ChordSystem::per_iteration_logic/mappings:" + std::to_string(num_mappings),
+                             2'000'000 / num_mappings, keys, [&]() { chord_system.per_iteration_logic(); });
+    }
+
+    chord_system.mapping_mode_active = false;
+    pipeline.set_pressed(EKey::SPACE, false);
+    pipeline.end_tick();
+    pipeline.end_tick();
+
+    layer.set_key_mappings(original_mappings);
+    chord_system.simultaneous_keypresses.combos = original_combos;
+}
+
+// a full KeyInterceptor::update per keystroke, read from the pipe and written to /dev/null through each backend
+void bench_input_output_backends(NullPipeline &pipeline) {
+    auto &key_interceptor = pipeline.chord_system->key_interceptor;
+    std::vector<std::string> backend_names = {"poll"};
+    if (io_uring_backend_is_available())
+        backend_names.push_back("io_uring");
+
+    for (bool event_sourced : {false, true}) {
+        for (const std::string &backend_name : backend_names) {
+            std::string mode = event_sourced ? "event_sourced/" : "";
+            std::string name = "KeyInterceptor::update/" + mode + "backend:" + backend_name;
+            if (not benchmark::should_run(name))
+                continue;
+
+            std::unique_ptr<InputOutputBackend> backend = create_input_output_backend(backend_name);
+            if (backend->get_name() != backend_name)
+                continue;
+            key_interceptor.set_input_output_backend(std::move(backend));
+            key_interceptor.event_sourced = event_sourced;
+
+            size_t tick = 0;
+            benchmark::run(name, 200'000, [&]() {
+                int value = tick % 2 == 0 ? LinuxInputAdapter::press_value : LinuxInputAdapter::release_value;
+                pipeline.write_events({make_event(EV_KEY, KEY_A, value), make_event(EV_SYN, SYN_REPORT, 0)});
+                key_interceptor.update();
+                tick++;
+            });
+        }
+    }
+
+    key_interceptor.event_sourced = false;
+    key_interceptor.set_input_output_backend(std::make_unique<PollBackend>());
+}
+
+// the steps of a KeyInterceptor::update tick (without tracing, injection or the stall watchdog) with the logic passed
+// in, so the same tick can run with the logic behind a std::function or visible to the compiler
+template <typename Logic> void update_with_logic(KeyInterceptor &key_interceptor, Logic &&logic) {
+    key_interceptor.poll_events();
+    key_interceptor.forward_relative_motion();
+    logic();
+    const KeyBitmapState &key_bitmap_state = key_interceptor.linux_input_adapter.key_bitmap_state;
+    key_interceptor.forward_keys(key_bitmap_state.get_just_pressed(), LinuxInputAdapter::press_value);
+    key_interceptor.forward_keys(key_bitmap_state.get_held(), LinuxInputAdapter::repeat_value);
+    key_interceptor.forward_keys(key_bitmap_state.get_just_released(), LinuxInputAdapter::release_value);
+    key_interceptor.forward_relative_motion();
+    key_interceptor.output_sink->flush();
+    key_interceptor.end_tick();
+}
+
+// the cost of calling the logic through KeyInterceptor's std::function compared to a lambda the compiler can see
+// through, the logic itself is a counter so the dispatch is most of what's left besides the read and write. This is
+// what KeyInterceptor being templated on its logic would save.
+void bench_logic_dispatch(NullPipeline &pipeline) {
+    KeyInterceptor &key_interceptor = pipeline.key_interceptor();
+    int num_logic_calls = 0;
+    auto count_logic_call = [&]() { num_logic_calls++; };
+
+    std::function<void()> original_logic = std::move(key_interceptor.logic);
+    key_interceptor.logic = count_logic_call;
+
+    auto run = [&](const std::string &name, auto &&logic) {
+        size_t tick = 0;
+        benchmark::run(name, 500'000, [&]() {
+            int value = tick % 2 == 0 ? LinuxInputAdapter::press_value : LinuxInputAdapter::release_value;
+            pipeline.write_events({make_event(EV_KEY, KEY_A, value), make_event(EV_SYN, SYN_REPORT, 0)});
+            update_with_logic(key_interceptor, logic);
+            tick++;
+        });
+    };
+
+    run("KeyInterceptor::update/logic:std::function", key_interceptor.logic);
+    run("KeyInterceptor::update/logic:template", count_logic_call);
+    benchmark::do_not_optimize(num_logic_calls);
+
+    key_interceptor.logic = std::move(original_logic);
+}
+
+// a physical keystroke per update with and without a frame of injected events arriving alongside it, the difference is
+// what receiving and queuing injected input adds to each update
+void bench_injection(NullPipeline &pipeline) {
+    auto &key_interceptor = pipeline.chord_system->key_interceptor;
+    std::string socket_path = "/tmp/key_interceptor_bench_injection_" + std::to_string(getpid()) + ".sock";
+    InjectionSocket injection_socket(socket_path);
+    if (not injection_socket.is_enabled())
+        return;
+    key_interceptor.set_injection_socket(&injection_socket);
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    int client_file_descriptor = socket(AF_UNIX, SOCK_DGRAM, 0);
+    connect(client_file_descriptor, reinterpret_cast<struct sockaddr *>(&address), sizeof(address));
+
+    const size_t events_per_frame = 8;
+    injection::FrameHeader header = {injection::magic, injection::version, events_per_frame};
+    std::vector<unsigned char> frame(injection::get_frame_size(events_per_frame));
+    memcpy(frame.data(), &header, sizeof(header));
+    for (size_t i = 0; i < events_per_frame; i++) {
+        injection::KeyEvent event = {KEY_F24, static_cast<uint8_t>(i % 2 == 0), 0};
+        memcpy(frame.data() + injection::get_frame_size(i), &event, sizeof(event));
+    }
+
+    for (bool inject : {false, true}) {
+        size_t tick = 0;
+        std::string name = std::string("KeyInterceptor::update/injection:") + (inject ? "frame_of_8" : "none");
+        benchmark::run(name, 200'000, [&]() {
+            int value = tick % 2 == 0 ? LinuxInputAdapter::press_value : LinuxInputAdapter::release_value;
+            pipeline.write_events({make_event(EV_KEY, KEY_A, value), make_event(EV_SYN, SYN_REPORT, 0)});
+            if (inject)
+                send(client_file_descriptor, frame.data(), frame.size(), 0);
+            key_interceptor.update();
+            tick++;
+        });
+    }
+
+    key_interceptor.set_injection_socket(nullptr);
+    close(client_file_descriptor);
+}
+
+// independent in-memory pipelines updated side by side on their own threads, if they share nothing the time of an
+// update stays the same as pipelines are added
+void bench_parallel_pipelines() {
+    const size_t num_updates = 200'000;
+
+    for (size_t num_pipelines : {1, 2, 4}) {
+        std::string name = "KeyInterceptor::update/parallel_pipelines:" + std::to_string(num_pipelines);
+        if (not benchmark::should_run(name))
+            continue;
+
+        std::vector<std::unique_ptr<ChordSystem>> chord_systems;
+        std::vector<InMemoryInputSource *> input_sources;
+        std::vector<InMemoryOutputSink *> output_sinks;
+        for (size_t i = 0; i < num_pipelines; i++) {
+            auto input_source = std::make_unique<InMemoryInputSource>();
+            auto output_sink = std::make_unique<InMemoryOutputSink>();
+            input_sources.push_back(input_source.get());
+            output_sinks.push_back(output_sink.get());
+            chord_systems.push_back(std::make_unique<ChordSystem>(std::move(input_source), std::move(output_sink)));
+        }
+
+        std::atomic<bool> start = false;
+        std::vector<double> ns_per_update(num_pipelines);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < num_pipelines; i++) {
+            threads.emplace_back([&, i]() {
+                auto &key_interceptor = chord_systems[i]->key_interceptor;
+                while (not start)
+                    std::this_thread::yield();
+
+                benchmark::Clock::time_point begin = benchmark::Clock::now();
+                for (size_t update = 0; update < num_updates; update++) {
+                    int value = update % 2 == 0 ? LinuxInputAdapter::press_value : LinuxInputAdapter::release_value;
+                    input_sources[i]->push({make_event(EV_KEY, KEY_A, value), make_event(EV_SYN, SYN_REPORT, 0)});
+                    key_interceptor.update();
+                    if (update % 64 == 0)
+                        benchmark::do_not_optimize(output_sinks[i]->take_events());
+                }
+                benchmark::Clock::time_point end = benchmark::Clock::now();
+                ns_per_update[i] = std::chrono::duration<double, std::nano>(end - begin).count() / num_updates;
+            });
+        }
+        start = true;
+        for (std::thread &thread : threads)
+            thread.join();
+
+        double total_ns_per_update = 0;
+        for (double ns : ns_per_update)
+            total_ns_per_update += ns;
+        benchmark::report(name, total_ns_per_update / num_pipelines, num_updates * num_pipelines);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    global_logger->remove_all_sinks();
+
+    if (argc > 1)
+        benchmark::filter = argv[1];
+
+    NullPipeline pipeline;
+
+    bench_evdev_decode(pipeline);
+    bench_translation(pipeline);
+    bench_send_key(pipeline);
+    bench_key_diffing(pipeline);
+    bench_simultaneous_keypresses(pipeline);
+    bench_per_iteration_logic(pipeline);
+    bench_input_output_backends(pipeline);
+    bench_logic_dispatch(pipeline);
+    bench_injection(pipeline);
+    bench_parallel_pipelines();
+}
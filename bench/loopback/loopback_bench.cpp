@@ -0,0 +1,290 @@
+#include "chord_system.hpp"
+#include "input_output_backend.hpp"
+#include "select_linux_device.hpp"
+
+#include "utility/logger/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief measures the interceptor end to end through the kernel: scripted typing is written to a uinput source
+ * keyboard, the interceptor reads it from the source's event node (grabbed, like a real keyboard) and forwards it to
+ * its virtual keyboard, whose event node is read back here. Nothing but uinput is needed, and both devices are grabbed
+ * so none of the typing reaches the desktop.
+ *
+ * Every press and release is matched with the one that comes out by key code and order, so the report covers
+ * throughput, events that never came out (loss) and the latency of the full round trip.
+ *
+ * Needs access to /dev/uinput and /dev/input, eg:
+ *
+ *     sudo ./key_interceptor_loopback_bench --rate=10000 --duration=2
+ */
+
+using Clock = std::chrono::steady_clock;
+
+struct Settings {
+    // key events (presses and releases) per second
+    double rate = 10000;
+    double duration_seconds = 2;
+    // how long each key is held, the interceptor only sees keys that are held for at least one of its ticks
+    double hold_ms = 3;
+    double tick_hz = 1000;
+    std::string io_backend_name = "poll";
+};
+
+struct ScriptedEvent {
+    Clock::duration time;
+    int code;
+    int value;
+};
+
+// rolling typing over the letters, a new key goes down every 2 / rate seconds and is released hold_ms later
+std::vector<ScriptedEvent> make_typing_script(const Settings &settings) {
+    const std::vector<int> letters = {KEY_A, KEY_B, KEY_C, KEY_D, KEY_E, KEY_F, KEY_G, KEY_H, KEY_I,
+                                      KEY_J, KEY_K, KEY_L, KEY_M, KEY_N, KEY_O, KEY_P, KEY_Q, KEY_R,
+                                      KEY_S, KEY_T, KEY_U, KEY_V, KEY_W, KEY_X, KEY_Y, KEY_Z};
+
+    auto press_interval = std::chrono::duration<double>(2.0 / settings.rate);
+    auto hold = std::chrono::duration<double, std::milli>(settings.hold_ms);
+    size_t num_presses = settings.rate * settings.duration_seconds / 2;
+
+    std::vector<ScriptedEvent> script;
+    for (size_t i = 0; i < num_presses; i++) {
+        auto press_time = std::chrono::duration_cast<Clock::duration>(press_interval * i);
+        auto release_time = press_time + std::chrono::duration_cast<Clock::duration>(hold);
+        int code = letters[i % letters.size()];
+        script.push_back({press_time, code, LinuxInputAdapter::press_value});
+        script.push_back({release_time, code, LinuxInputAdapter::release_value});
+    }
+
+    std::stable_sort(script.begin(), script.end(),
+                     [](const ScriptedEvent &a, const ScriptedEvent &b) { return a.time < b.time; });
+    return script;
+}
+
+/**
+ * @brief the send time of every event that was injected but hasn't come out yet, per key code and value so that the
+ * n-th press of a key is matched with the n-th press that comes out
+ */
+struct InFlightEvents {
+    std::mutex mutex;
+    std::deque<Clock::time_point> send_times[KEY_CNT][2];
+
+    void add(int code, int value, Clock::time_point send_time) {
+        std::lock_guard lock(mutex);
+        send_times[code][value].push_back(send_time);
+    }
+
+    // returns false if nothing matching was sent
+    bool take(int code, int value, Clock::time_point &send_time) {
+        std::lock_guard lock(mutex);
+        auto &queue = send_times[code][value];
+        if (queue.empty())
+            return false;
+        send_time = queue.front();
+        queue.pop_front();
+        return true;
+    }
+
+    size_t count() {
+        std::lock_guard lock(mutex);
+        size_t total = 0;
+        for (const auto &queues : send_times)
+            for (const auto &queue : queues)
+                total += queue.size();
+        return total;
+    }
+};
+
+void inject(int source_file_descriptor, const std::vector<ScriptedEvent> &script, InFlightEvents &in_flight_events) {
+    Clock::time_point start = Clock::now();
+    std::vector<struct input_event> batch;
+    std::vector<const ScriptedEvent *> batch_events;
+
+    size_t i = 0;
+    while (i < script.size()) {
+        std::this_thread::sleep_until(start + script[i].time);
+
+        // NOTE: everything that is due goes out in one write, at high rates the sleep is coarser than the script
+        Clock::time_point now = Clock::now();
+        batch.clear();
+        batch_events.clear();
+        for (; i < script.size() and start + script[i].time <= now; i++) {
+            struct input_event ev{};
+            ev.type = EV_KEY;
+            ev.code = script[i].code;
+            ev.value = script[i].value;
+            batch.push_back(ev);
+            ev.type = EV_SYN;
+            ev.code = SYN_REPORT;
+            ev.value = 0;
+            batch.push_back(ev);
+            batch_events.push_back(&script[i]);
+        }
+
+        Clock::time_point send_time = Clock::now();
+        for (const ScriptedEvent *scripted_event : batch_events)
+            in_flight_events.add(scripted_event->code, scripted_event->value, send_time);
+
+        if (write(source_file_descriptor, batch.data(), batch.size() * sizeof(struct input_event)) < 0)
+            perror("write loopback source");
+    }
+}
+
+double get_percentile_us(const std::vector<Clock::duration> &sorted_latencies, double fraction) {
+    if (sorted_latencies.empty())
+        return 0;
+    size_t index = std::min(sorted_latencies.size() - 1, static_cast<size_t>(fraction * sorted_latencies.size()));
+    return std::chrono::duration<double, std::micro>(sorted_latencies[index]).count();
+}
+
+void destroy_uinput_device(int file_descriptor) {
+    ioctl(file_descriptor, UI_DEV_DESTROY);
+    close(file_descriptor);
+}
+
+int main(int argc, char *argv[]) {
+    global_logger->remove_all_sinks();
+
+    Settings settings;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value_of = [&](const std::string &prefix) { return arg.substr(prefix.size()); };
+        if (arg.starts_with("--rate=")) {
+            settings.rate = std::stod(value_of("--rate="));
+        } else if (arg.starts_with("--duration=")) {
+            settings.duration_seconds = std::stod(value_of("--duration="));
+        } else if (arg.starts_with("--hold-ms=")) {
+            settings.hold_ms = std::stod(value_of("--hold-ms="));
+        } else if (arg.starts_with("--tick-hz=")) {
+            settings.tick_hz = std::stod(value_of("--tick-hz="));
+        } else if (arg.starts_with("--io-backend=")) {
+            settings.io_backend_name = value_of("--io-backend=");
+        } else {
+            std::cerr << "usage: key_interceptor_loopback_bench [--rate=events_per_second] [--duration=seconds] "
+                         "[--hold-ms=ms] [--tick-hz=hz] [--io-backend=poll|io_uring]\n";
+            return 1;
+        }
+    }
+
+    int source_file_descriptor = create_virtual_keyboard_device("Key Interceptor Loopback Source");
+    int virtual_keyboard_file_descriptor = create_virtual_keyboard_device();
+    // NOTE: udev needs a moment to create the event nodes
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    std::string source_event_path = get_uinput_device_event_path(source_file_descriptor);
+    std::string virtual_keyboard_event_path = get_uinput_device_event_path(virtual_keyboard_file_descriptor);
+    if (source_event_path.empty() or virtual_keyboard_event_path.empty()) {
+        std::cerr << "couldn't find the event nodes of the uinput devices\n";
+        destroy_uinput_device(virtual_keyboard_file_descriptor);
+        destroy_uinput_device(source_file_descriptor);
+        return 1;
+    }
+
+    int sink_file_descriptor = open(virtual_keyboard_event_path.c_str(), O_RDONLY | O_NONBLOCK);
+    if (sink_file_descriptor < 0) {
+        perror("open forwarded virtual keyboard");
+        destroy_uinput_device(virtual_keyboard_file_descriptor);
+        destroy_uinput_device(source_file_descriptor);
+        return 1;
+    }
+    // keeps the forwarded typing away from the desktop
+    if (ioctl(sink_file_descriptor, EVIOCGRAB, 1) < 0)
+        perror("EVIOCGRAB forwarded virtual keyboard");
+
+    ChordSystem chord_system(source_event_path, virtual_keyboard_file_descriptor, true);
+    chord_system.key_interceptor.set_input_output_backend(create_input_output_backend(settings.io_backend_name));
+
+    std::atomic<bool> interceptor_running = true;
+    std::thread interceptor_thread([&]() {
+        auto tick = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / settings.tick_hz));
+        Clock::time_point next_tick = Clock::now();
+        while (interceptor_running) {
+            chord_system.key_interceptor.update();
+            next_tick += tick;
+            std::this_thread::sleep_until(next_tick);
+        }
+    });
+
+    std::vector<ScriptedEvent> script = make_typing_script(settings);
+    InFlightEvents in_flight_events;
+    std::atomic<bool> injecting = true;
+    Clock::time_point injection_start = Clock::now();
+    std::thread injector_thread([&]() {
+        inject(source_file_descriptor, script, in_flight_events);
+        injecting = false;
+    });
+
+    std::vector<Clock::duration> latencies;
+    latencies.reserve(script.size());
+    size_t num_unexpected_events = 0;
+
+    // keep reading for a while after the script ends so events still in flight aren't counted as lost
+    auto drain_time = std::chrono::milliseconds(250);
+    Clock::time_point injection_end;
+    bool injection_finished = false;
+    while (not injection_finished or Clock::now() < injection_end + drain_time) {
+        if (not injection_finished and not injecting) {
+            injection_finished = true;
+            injection_end = Clock::now();
+        }
+
+        struct pollfd poll_file_descriptor = {sink_file_descriptor, POLLIN, 0};
+        if (poll(&poll_file_descriptor, 1, 10) <= 0)
+            continue;
+
+        struct input_event events[64];
+        ssize_t n;
+        while ((n = read(sink_file_descriptor, events, sizeof(events))) > 0) {
+            Clock::time_point receive_time = Clock::now();
+            for (size_t i = 0; i < n / sizeof(struct input_event); i++) {
+                const input_event &ev = events[i];
+                if (ev.type != EV_KEY or ev.value == LinuxInputAdapter::repeat_value)
+                    continue;
+
+                Clock::time_point send_time;
+                if (in_flight_events.take(ev.code, ev.value, send_time))
+                    latencies.push_back(receive_time - send_time);
+                else
+                    num_unexpected_events++;
+            }
+        }
+    }
+
+    injector_thread.join();
+    interceptor_running = false;
+    interceptor_thread.join();
+
+    double injection_seconds = std::chrono::duration<double>(injection_end - injection_start).count();
+    size_t num_lost_events = in_flight_events.count();
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "backend " << chord_system.key_interceptor.input_output_backend->get_name() << ", tick "
+              << settings.tick_hz << "hz, hold " << settings.hold_ms << "ms\n";
+    std::cout << "injected " << script.size() << " key events in " << injection_seconds << "s ("
+              << script.size() / injection_seconds << " events/s)\n";
+    std::cout << "forwarded " << latencies.size() << " (" << latencies.size() / injection_seconds << " events/s), lost "
+              << num_lost_events << ", unexpected " << num_unexpected_events << "\n";
+    std::cout << "latency p50 " << get_percentile_us(latencies, 0.5) << "us, p99 " << get_percentile_us(latencies, 0.99)
+              << "us, max " << get_percentile_us(latencies, 1.0) << "us\n";
+
+    ioctl(sink_file_descriptor, EVIOCGRAB, 0);
+    close(sink_file_descriptor);
+    // NOTE: the chord system is done with the forwarded virtual keyboard once its thread has been joined, left alone it
+    // would stay around until the process exits
+    destroy_uinput_device(virtual_keyboard_file_descriptor);
+    destroy_uinput_device(source_file_descriptor);
+
+    return num_lost_events == 0 and num_unexpected_events == 0 ? 0 : 1;
+}
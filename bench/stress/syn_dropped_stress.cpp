@@ -0,0 +1,197 @@
+#include "key_interceptor.hpp"
+#include "select_linux_device.hpp"
+
+#include "utility/logger/logger.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief forces the kernel's evdev buffer to overflow and checks that the interceptor comes out of it with the same
+ * keys held as the device, and that it only emitted the differences while resyncing.
+ *
+ * A uinput device stands in for the keyboard, every round a flood of random presses and releases far larger than the
+ * evdev buffer is written to it while the interceptor isn't reading, ending on a known set of held keys. The output
+ * goes into a pipe instead of a virtual keyboard so nothing reaches the desktop and every emitted event can be checked.
+ *
+ * Needs access to /dev/uinput and /dev/input, eg: sudo ./key_interceptor_syn_dropped_stress [rounds] [flood_frames]
+ */
+
+struct OutputRecorder {
+    int pipe_file_descriptors[2];
+    std::bitset<KEY_CNT> pressed;
+    // a press of a key that was already down or a release of one that was already up
+    size_t num_redundant_events = 0;
+
+    OutputRecorder() {
+        if (pipe2(pipe_file_descriptors, O_NONBLOCK) < 0) {
+            throw std::runtime_error("Failed to create the output pipe");
+        }
+    }
+
+    ~OutputRecorder() {
+        close(pipe_file_descriptors[0]);
+        close(pipe_file_descriptors[1]);
+    }
+
+    int get_write_file_descriptor() const { return pipe_file_descriptors[1]; }
+
+    void drain() {
+        struct input_event events[64];
+        ssize_t n;
+        while ((n = read(pipe_file_descriptors[0], events, sizeof(events))) > 0) {
+            for (size_t i = 0; i < n / sizeof(struct input_event); i++) {
+                const input_event &ev = events[i];
+                if (ev.type != EV_KEY or ev.value == LinuxInputAdapter::repeat_value)
+                    continue;
+
+                bool is_pressed = ev.value == LinuxInputAdapter::press_value;
+                if (pressed.test(ev.code) == is_pressed)
+                    num_redundant_events++;
+                pressed.set(ev.code, is_pressed);
+            }
+        }
+    }
+};
+
+void write_key_frames(int ufd, const std::vector<std::pair<int, int>> &code_and_values) {
+    std::vector<struct input_event> events;
+    for (const auto &[code, value] : code_and_values) {
+        struct input_event ev{};
+        ev.type = EV_KEY;
+        ev.code = code;
+        ev.value = value;
+        events.push_back(ev);
+        ev.type = EV_SYN;
+        ev.code = SYN_REPORT;
+        ev.value = 0;
+        events.push_back(ev);
+    }
+
+    // NOTE: uinput hands every event in a write to the input core at once, which is what overflows the reader
+    size_t chunk_size = 512;
+    for (size_t i = 0; i < events.size(); i += chunk_size) {
+        size_t num_events = std::min(chunk_size, events.size() - i);
+        if (write(ufd, events.data() + i, num_events * sizeof(struct input_event)) < 0) {
+            perror("write stress source");
+            return;
+        }
+    }
+}
+
+// runs the interceptor until it has read everything the source device wrote
+void update_until_idle(KeyInterceptor &key_interceptor, OutputRecorder &output_recorder) {
+    for (int i = 0; i < 10; i++) {
+        key_interceptor.update();
+        output_recorder.drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    global_logger->remove_all_sinks();
+
+    int num_rounds = argc > 1 ? std::stoi(argv[1]) : 50;
+    int num_flood_frames = argc > 2 ? std::stoi(argv[2]) : 8192;
+
+    int source_file_descriptor = create_virtual_keyboard_device("Key Interceptor Stress Source");
+    // NOTE: udev needs a moment to create the event node
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    std::string source_event_path = get_uinput_device_event_path(source_file_descriptor);
+    if (source_event_path.empty()) {
+        std::cerr << "couldn't find the event node of the stress source device\n";
+        return 1;
+    }
+
+    OutputRecorder output_recorder;
+    KeyInterceptor key_interceptor([]() {}, source_event_path, output_recorder.get_write_file_descriptor(), true);
+
+    std::vector<int> key_codes;
+    for (const auto &[linux_code, key_enum] : key_interceptor.linux_input_adapter.linux_code_to_key_enum)
+        key_codes.push_back(linux_code);
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<size_t> random_key(0, key_codes.size() - 1);
+    std::bernoulli_distribution random_press(0.5);
+    std::bernoulli_distribution random_held(0.1);
+
+    std::bitset<KEY_CNT> source_pressed;
+    int num_failed_rounds = 0;
+    int num_rounds_that_overflowed = 0;
+
+    for (int round = 0; round < num_rounds; round++) {
+        size_t num_syn_dropped_before = key_interceptor.linux_input_adapter.get_num_syn_dropped();
+        size_t num_redundant_events_before = output_recorder.num_redundant_events;
+
+        std::vector<std::pair<int, int>> frames;
+        for (int i = 0; i < num_flood_frames; i++) {
+            int code = key_codes[random_key(rng)];
+            bool press = random_press(rng);
+            frames.emplace_back(code, press ? LinuxInputAdapter::press_value : LinuxInputAdapter::release_value);
+            source_pressed.set(code, press);
+        }
+
+        // end on a known set of held keys
+        std::bitset<KEY_CNT> target_pressed;
+        for (int code : key_codes) {
+            bool held = random_held(rng);
+            target_pressed.set(code, held);
+            if (source_pressed.test(code) != held)
+                frames.emplace_back(code, held ? LinuxInputAdapter::press_value : LinuxInputAdapter::release_value);
+        }
+        source_pressed = target_pressed;
+
+        write_key_frames(source_file_descriptor, frames);
+        update_until_idle(key_interceptor, output_recorder);
+
+        bool overflowed = key_interceptor.linux_input_adapter.get_num_syn_dropped() > num_syn_dropped_before;
+        if (overflowed)
+            num_rounds_that_overflowed++;
+
+        int num_input_mismatches = 0;
+        int num_output_mismatches = 0;
+        for (const auto &[linux_code, key_enum] : key_interceptor.linux_input_adapter.linux_code_to_key_enum) {
+            bool expected = target_pressed.test(linux_code);
+            if (key_interceptor.input_state.is_pressed(key_enum) != expected)
+                num_input_mismatches++;
+            if (output_recorder.pressed.test(key_interceptor.key_enum_to_linux_code.at(key_enum)) != expected)
+                num_output_mismatches++;
+        }
+        size_t num_redundant_events = output_recorder.num_redundant_events - num_redundant_events_before;
+
+        bool failed = num_input_mismatches > 0 or num_output_mismatches > 0 or num_redundant_events > 0;
+        if (failed)
+            num_failed_rounds++;
+
+        std::cout << "round " << round << (overflowed ? " overflowed" : " did not overflow")
+                  << ", input state mismatches: " << num_input_mismatches
+                  << ", virtual keyboard mismatches: " << num_output_mismatches
+                  << ", redundant events: " << num_redundant_events << (failed ? "  FAILED" : "") << "\n";
+    }
+
+    // let go of everything before the device disappears
+    std::vector<std::pair<int, int>> releases;
+    for (int code : key_codes)
+        if (source_pressed.test(code))
+            releases.emplace_back(code, LinuxInputAdapter::release_value);
+    write_key_frames(source_file_descriptor, releases);
+    update_until_idle(key_interceptor, output_recorder);
+
+    ioctl(source_file_descriptor, UI_DEV_DESTROY);
+    close(source_file_descriptor);
+
+    std::cout << "\n" << num_rounds_that_overflowed << "/" << num_rounds << " rounds overflowed the evdev buffer, "
+              << num_failed_rounds << " failed\n";
+    if (num_rounds_that_overflowed == 0)
+        std::cout << "nothing overflowed, try a larger flood_frames\n";
+
+    return num_failed_rounds == 0 ? 0 : 1;
+}
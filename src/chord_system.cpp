@@ -0,0 +1,409 @@
+#include "chord_system.hpp"
+
+#include "select_linux_device.hpp"
+
+#include "utility/collection_utils/collection_utils.hpp"
+#include "utility/logger/logger.hpp"
+
+#include <algorithm>
+
+ChordSystem::ChordSystem()
+    : ChordSystem(interactively_select_linux_device_name(), create_virtual_keyboard_device(), true) {}
+
+ChordSystem::ChordSystem(const std::string &device_name, int virtual_keyboard_file_descriptor, bool exclusive_control)
+    : key_interceptor([this]() { per_iteration_logic(); }, device_name, virtual_keyboard_file_descriptor,
+                      exclusive_control) {
+    initialize_key_maps();
+    key_interceptor.add_wake_up_source(mouse_keys.get_wake_up_file_descriptor());
+}
+
+ChordSystem::ChordSystem(std::unique_ptr<InputSource> input_source, std::unique_ptr<OutputSink> output_sink)
+    : key_interceptor([this]() { per_iteration_logic(); }, std::move(input_source), std::move(output_sink)) {
+    initialize_key_maps();
+    key_interceptor.add_wake_up_source(mouse_keys.get_wake_up_file_descriptor());
+}
+
+void ChordSystem::initialize_key_maps() {
+    for (size_t i = 0; i < key_maps.size(); i++)
+        key_maps[i].map_name = static_cast<MapName>(i);
+
+    // NOTE: the built-in layers are constexpr tables used in place, see static_layers.hpp
+    get_key_map(MapName::homesick).set_key_mappings(static_layers::homesick.key_mappings);
+    get_key_map(MapName::number_pulldown).set_key_mappings(static_layers::number_pulldown.key_mappings);
+    get_key_map(MapName::programming).set_key_mappings(static_layers::programming.key_mappings);
+    get_key_map(MapName::vim_arrows).set_key_mappings(static_layers::vim_arrows.key_mappings);
+    get_key_map(MapName::mouse_keys).set_key_mappings(static_layers::mouse_keys.key_mappings);
+
+    for (auto &key : input_state.all_keys) {
+        if (key.shiftable) {
+            shift_lock_key_mappings.push_back({key.key_enum, key.key_enum_of_shifted_version});
+        }
+    }
+    get_key_map(MapName::shift_lock).set_key_mappings(shift_lock_key_mappings);
+
+    if (not space_tap_mapping_activation_mode) {
+
+        // NOTE: registered in table order so that a combo's index is its position in the table, space + key
+        // activates the combo's layer
+        for (const auto &mapping_combo : static_layers::mapping_combos)
+            simultaneous_keypresses.register_combo(EKey::SPACE, mapping_combo.key);
+    }
+}
+
+void ChordSystem::activate_mapping(const static_layers::MappingCombo &mapping_combo) {
+    mapping_mode_active = true;
+    current_mapping = mapping_combo.map_name;
+    key_used_to_start_mapping = mapping_combo.key;
+}
+
+void ChordSystem::retract_speculative_space() {
+    global_logger->debug("retracting speculative space");
+    for (EKey key : speculative_space_undo_keys)
+        key_interceptor.send_key_to_virtual_keyboard(key, LinuxInputAdapter::press_value);
+    for (auto it = speculative_space_undo_keys.rbegin(); it != speculative_space_undo_keys.rend(); it++)
+        key_interceptor.send_key_to_virtual_keyboard(*it, LinuxInputAdapter::release_value);
+    speculative_space_sent = false;
+}
+
+void ChordSystem::set_usage_statistics(UsageStatistics *usage_statistics) {
+    this->usage_statistics = usage_statistics;
+    simultaneous_keypresses.usage_statistics = usage_statistics;
+    auto &debounce = key_interceptor.linux_input_adapter.debounce;
+    debounce.on_suppressed_bounce = nullptr;
+    if (usage_statistics == nullptr)
+        return;
+
+    debounce.on_suppressed_bounce = [usage_statistics](int linux_code) {
+        usage_statistics->record_suppressed_bounce(linux_code);
+    };
+
+    for (const KeyMap &key_map : key_maps)
+        usage_statistics->set_layer_name(static_cast<size_t>(key_map.map_name), to_string(key_map.map_name));
+
+    for (const auto &[linux_code, key_enum] : key_interceptor.linux_input_adapter.linux_code_to_key_enum)
+        usage_statistics->set_key_name(linux_code, input_state.key_enum_to_object.at(key_enum)->string_repr);
+
+    const auto &key_enum_to_linux_code = key_interceptor.key_enum_to_linux_code;
+    for (size_t i = 0; i < simultaneous_keypresses.combos.size(); i++) {
+        const auto &combo = simultaneous_keypresses.combos[i];
+        usage_statistics->set_combo(i, key_enum_to_linux_code.at(combo.key1), key_enum_to_linux_code.at(combo.key2),
+                                    static_cast<int>(static_layers::mapping_combos.at(i).map_name));
+    }
+    usage_statistics->set_combo_threshold(simultaneous_keypresses.threshold);
+}
+
+void ChordSystem::set_combo_threshold_learner(ComboThresholdLearner *combo_threshold_learner) {
+    this->combo_threshold_learner = combo_threshold_learner;
+    simultaneous_keypresses.combo_threshold_learner = combo_threshold_learner;
+    if (combo_threshold_learner == nullptr)
+        return;
+
+    const auto &key_enum_to_linux_code = key_interceptor.key_enum_to_linux_code;
+    for (size_t i = 0; i < simultaneous_keypresses.combos.size(); i++) {
+        auto &combo = simultaneous_keypresses.combos[i];
+        combo_threshold_learner->set_combo(i, key_enum_to_linux_code.at(combo.key1),
+                                           key_enum_to_linux_code.at(combo.key2));
+        // NOTE: what was learned in earlier runs applies right away
+        if (auto learned_threshold = combo_threshold_learner->get_learned_threshold(i))
+            combo.threshold = *learned_threshold;
+    }
+}
+
+void ChordSystem::set_state_snapshot_publisher(StateSnapshotPublisher *state_snapshot_publisher) {
+    this->state_snapshot_publisher = state_snapshot_publisher;
+    if (state_snapshot_publisher == nullptr)
+        return;
+
+    for (const KeyMap &key_map : key_maps)
+        state_snapshot_publisher->set_layer_name(static_cast<size_t>(key_map.map_name), to_string(key_map.map_name));
+}
+
+state_snapshot::Snapshot ChordSystem::get_state_snapshot() const {
+    state_snapshot::Snapshot snapshot{};
+
+    static_assert(state_snapshot::num_key_bitmap_words == KeyBitmap::num_words);
+    const KeyBitmap &physical_keys = key_interceptor.linux_input_adapter.key_bitmap_state.current;
+    std::copy(physical_keys.words.begin(), physical_keys.words.end(), snapshot.physical_keys);
+    std::copy(key_interceptor.virtual_keys.words.begin(), key_interceptor.virtual_keys.words.end(),
+              snapshot.virtual_keys);
+
+    // NOTE: only one layer can be active at a time right now, the stack leaves room for layers on top of layers
+    if (mapping_mode_active) {
+        snapshot.layer_stack[0] = static_cast<uint8_t>(current_mapping);
+        snapshot.layer_stack_depth = 1;
+    }
+
+    if (mapping_mode_active)
+        snapshot.mode_flags |= state_snapshot::mapping_mode_active;
+    if (space_tap_mapping_activation_mode)
+        snapshot.mode_flags |= state_snapshot::space_tap_mapping_activation_mode;
+    if (possibly_going_into_mapping_mode)
+        snapshot.mode_flags |= state_snapshot::possibly_going_into_mapping_mode;
+
+    snapshot.last_combo_gap_ms = static_cast<uint32_t>(simultaneous_keypresses.last_duration.count());
+    return snapshot;
+}
+
+void ChordSystem::publish_state_snapshot() {
+    if (state_snapshot_publisher != nullptr)
+        state_snapshot_publisher->publish(get_state_snapshot());
+}
+
+void ChordSystem::per_iteration_logic() {
+
+    GlobalLogSection _("tick", logging_enabled);
+    TraceScope trace_scope("tick");
+
+    bool mapping_mode_was_active = mapping_mode_active;
+    if (usage_statistics != nullptr)
+        usage_statistics->record_tick();
+
+    if (space_tap_mapping_activation_mode) {
+        global_logger->debug("space signal state: {}",
+                             input_state.key_enum_to_object.at(EKey::SPACE)->pressed_signal.to_string());
+
+        if (input_state.is_just_pressed(EKey::SPACE)) {
+            if (mapping_mode_activation_timer.time_up() or not timer_started_at_least_once) {
+                mapping_mode_active = false;
+                mapping_mode_activation_timer.start();
+                mapping_mode_activation_deadline = std::chrono::steady_clock::now() + mapping_mode_activation_window;
+                possibly_going_into_mapping_mode = true;
+                timer_started_at_least_once = true;
+
+                if (speculative_space and not speculative_space_paused) {
+                    key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::press_value);
+                    key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::release_value);
+                    speculative_space_sent = true;
+                }
+            } else { // the timer was not up
+                mapping_mode_active = true;
+                global_logger->debug("chord started");
+
+                // NOTE: sent before anything the layer maps so the undo can't eat a mapped key
+                if (speculative_space_sent)
+                    retract_speculative_space();
+            }
+            // If you manually press space, it gets ignored
+            key_interceptor.keys_to_ignore_this_update.push_back(EKey::SPACE);
+        }
+
+        // only if the time for the chord to start elapsed and you had pressed space we do a slightly delayed space
+        // emission
+        if (not mapping_mode_active and mapping_mode_activation_timer.time_up() and
+            possibly_going_into_mapping_mode) {
+            if (not speculative_space_sent) {
+                key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::press_value);
+                key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::release_value);
+            }
+            // you took too long so we're longer trying to
+            possibly_going_into_mapping_mode = false;
+            speculative_space_sent = false;
+        }
+
+        // TODO: this doesn't work because it needs to not be reset per iteration because it doesn't have any effect
+        // because it cannot effect more than one iteration and chord keys come through on different iterations
+        int num_consecutive_keys_to_modify = 1;
+
+        // chord ends here
+        if (input_state.is_just_released(EKey::SPACE) and mapping_mode_active) {
+            mapping_mode_active = false;
+            // turn off all possible output keys from the chord mapping so they don't repeat if they were held down
+            // when space was released.
+            KeyMap &key_map = get_key_map(MapName::homesick);
+            for (size_t i = 0; i < key_map.key_mappings.size(); i++) {
+                const static_layers::KeyMapping &km = key_map.key_mappings[i];
+
+                // leave actively pressed keys on.
+                if (input_state.is_pressed(km.input_key))
+                    continue;
+
+                // release all other keys
+                key_map.active[i] = false;
+
+                global_logger->info("about to turn off key: {}",
+                                    input_state.key_enum_to_object.at(km.input_key)->string_repr);
+
+                key_interceptor.send_key_to_virtual_keyboard(km.output_key, LinuxInputAdapter::release_value);
+            }
+        }
+
+        auto just_pressed_keys = input_state.get_just_pressed_keys();
+        bool used_non_space_key =
+            not collection_utils::contains(just_pressed_keys, EKey::SPACE) and not just_pressed_keys.empty();
+        // when you type somethign like  "<space>a" we immediately emit the space key before this key so that you
+        // can type at full speed.
+        if (not mapping_mode_active and used_non_space_key and possibly_going_into_mapping_mode) {
+            if (not speculative_space_sent) {
+                key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::press_value);
+                key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::release_value);
+            }
+            possibly_going_into_mapping_mode = false;
+            // the space is followed by another character now, taking it back would delete that instead
+            speculative_space_sent = false;
+        }
+
+    } else {
+
+        simultaneous_keypresses.process(
+            [this](size_t combo_index) { activate_mapping(static_layers::mapping_combos[combo_index]); });
+
+        // when you do space-f and then let go of f we still want to ignore space
+        if (mapping_mode_active) {
+            if (input_state.is_pressed(EKey::SPACE)) {
+                key_interceptor.keys_to_ignore_this_update.push_back(EKey::SPACE);
+            }
+        }
+
+        if (input_state.is_just_released(EKey::SPACE) and mapping_mode_active) {
+            mapping_mode_active = false;
+            // turn off all possible output keys from the chord mapping so they don't repeat if they were held down
+            // when space was released.
+            KeyMap &key_map = get_key_map(current_mapping);
+            for (size_t i = 0; i < key_map.key_mappings.size(); i++) {
+                const static_layers::KeyMapping &km = key_map.key_mappings[i];
+
+                // leave actively pressed keys on.
+                if (input_state.is_pressed(km.input_key))
+                    continue;
+
+                // release all other keys
+                key_map.active[i] = false;
+
+                global_logger->info("about to turn off key: {}",
+                                    input_state.key_enum_to_object.at(km.input_key)->string_repr);
+
+                // std::cout << "about to turn off key: {}"
+                //           << input_state.key_enum_to_object.at(km.input_key)->string_repr << std::endl;
+
+                key_interceptor.send_key_to_virtual_keyboard(km.output_key, LinuxInputAdapter::release_value);
+            }
+        }
+    }
+
+    KeyMap &current_key_map = get_key_map(current_mapping);
+
+    // TODO: generalize with more stuff later
+    if (mapping_mode_active) {
+        std::fill(current_key_map.active.begin(), current_key_map.active.end(), true);
+    }
+
+    // this does the mappings
+    for (size_t i = 0; i < current_key_map.key_mappings.size(); i++) {
+        const static_layers::KeyMapping &cm = current_key_map.key_mappings[i];
+
+        // if you do space-f then don't run the f function
+        if (not current_key_map.active[i] or cm.input_key == key_used_to_start_mapping)
+            continue;
+
+        int value;
+        switch (input_state.get_current_state(cm.input_key)) {
+        case TemporalBinarySwitch::State::just_switched_on:
+            possibly_going_into_mapping_mode = false;
+            value = LinuxInputAdapter::press_value;
+            if (usage_statistics != nullptr)
+                usage_statistics->record_remapped_key_press(static_cast<size_t>(current_mapping),
+                                                            key_interceptor.key_enum_to_linux_code.at(cm.input_key));
+            break;
+        case TemporalBinarySwitch::State::sustained_on:
+            value = LinuxInputAdapter::repeat_value;
+            break;
+        case TemporalBinarySwitch::State::just_switched_off:
+            value = LinuxInputAdapter::release_value;
+            current_key_map.active[i] = false;
+            break;
+        case TemporalBinarySwitch::State::sustained_off:
+            // doesn't need to be modeled by exclusion
+            continue; // we don't even send akey in this case
+            break;
+        }
+
+        global_logger->info("about to turn on key: {}",
+                            input_state.key_enum_to_object.at(cm.input_key)->string_repr);
+
+        key_interceptor.keys_to_ignore_this_update.push_back(cm.input_key);
+
+        key_interceptor.send_key_to_virtual_keyboard(cm.output_key, value);
+        // transform_input_key_to_output_key(cm.input_key, cm.output_key);
+    }
+
+    update_mouse_keys();
+    send_mouse_keys_motion();
+
+    if (usage_statistics != nullptr and mapping_mode_active and not mapping_mode_was_active)
+        usage_statistics->record_layer_activation(static_cast<size_t>(current_mapping));
+}
+
+int ChordSystem::get_idle_timeout_ms(int max_timeout_ms) const {
+    using std::chrono::milliseconds;
+    milliseconds timeout(max_timeout_ms);
+
+    // NOTE: rounded up, waking up just before a deadline would only go back to sleep for 0ms
+    bool waiting_for_activation_window = space_tap_mapping_activation_mode and possibly_going_into_mapping_mode and
+                                         not mapping_mode_active;
+    if (waiting_for_activation_window)
+        timeout = std::min(timeout, std::chrono::ceil<milliseconds>(mapping_mode_activation_deadline -
+                                                                    std::chrono::steady_clock::now()));
+
+    if (auto time_until_next_settle = key_interceptor.linux_input_adapter.get_time_until_next_settle())
+        timeout = std::min(timeout, std::chrono::ceil<milliseconds>(*time_until_next_settle));
+
+    return std::max<int>(timeout.count(), 0);
+}
+
+void ChordSystem::update_mouse_keys() {
+    bool mouse_keys_layer_active = mapping_mode_active and current_mapping == MapName::mouse_keys;
+
+    for (EKey key : mouse_keys_movement_keys) {
+        bool in_use = collection_utils::contains(mouse_keys_movement_keys_in_use, key);
+        if (mouse_keys_layer_active and input_state.is_just_pressed(key) and not in_use) {
+            mouse_keys_movement_keys_in_use.push_back(key);
+            in_use = true;
+        }
+
+        if (not in_use)
+            continue;
+
+        key_interceptor.keys_to_ignore_this_update.push_back(key);
+        if (not input_state.is_pressed(key)) {
+            std::erase(mouse_keys_movement_keys_in_use, key);
+        }
+    }
+
+    if (not mouse_keys_layer_active) {
+        mouse_keys.set_direction(0, 0, 0);
+        return;
+    }
+
+    auto held = [&](EKey key) { return input_state.is_pressed(key) ? 1 : 0; };
+    mouse_keys.set_direction(held(EKey::l) - held(EKey::h), held(EKey::j) - held(EKey::k),
+                             held(EKey::u) - held(EKey::n));
+}
+
+void ChordSystem::send_mouse_keys_motion() {
+    // NOTE: taken every update, the motion still left over after the keys were let go is sent as well
+    MouseKeys::Motion mouse_keys_motion = mouse_keys.take_motion();
+    LinuxInputAdapter::RelativeMotion motion;
+    motion.x = mouse_keys_motion.x;
+    motion.y = mouse_keys_motion.y;
+    motion.wheel = mouse_keys_motion.wheel;
+    motion.wheel_hi_res = mouse_keys_motion.wheel_hi_res;
+    key_interceptor.queue_relative_motion(motion);
+}
+
+std::string to_string(ChordSystem::MapName map_name) {
+    switch (map_name) {
+    case ChordSystem::MapName::homesick:
+        return "homesick";
+    case ChordSystem::MapName::number_pulldown:
+        return "number_pulldown";
+    case ChordSystem::MapName::programming:
+        return "programming";
+    case ChordSystem::MapName::shift_lock:
+        return "shift_lock";
+    case ChordSystem::MapName::vim_arrows:
+        return "vim_arrows";
+    case ChordSystem::MapName::mouse_keys:
+        return "mouse_keys";
+    }
+    return "unknown";
+}
@@ -0,0 +1,196 @@
+#ifndef CHORD_SYSTEM_HPP
+#define CHORD_SYSTEM_HPP
+
+#include "combo_threshold_learner.hpp"
+#include "key_interceptor.hpp"
+#include "mouse_keys.hpp"
+#include "simultaneous_keypresses.hpp"
+#include "state_snapshot.hpp"
+#include "static_layers.hpp"
+#include "usage_statistics.hpp"
+
+#include "utility/temporal_binary_switch/temporal_binary_switch.hpp"
+#include "utility/timer/timer.hpp"
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ *
+ * Motivation:
+ *
+ * vim taught us that we can avoid reaching for our mouse. Once mastered, we should continue this pattern in memory of
+ * vim. Moreover if you are a programmer or someone who usese the computer for a lot of time then you should be
+ * investing in the ability to continue doing this. If one day you got a repetitive strain injury and were no longer
+ * able to type anymore it would be a sad day.
+ *
+ * Ok so applying the same reasoning that moving your hand is bad, then we just have to see how we currently move our
+ * hand. Most vimmers already rebind escape to caps lock because they understand this concept, but thats usually where
+ * it ends. Let's not stop there, instead we should realize that anytime we have to move away from the homerow this is
+ * usually a hand movement, the worst offenders are those where we have to slightly adjust the hand to reach our pinky
+ * out to grab a key, such as caps lock, delete, tab, enter etc.
+ *
+ * Our solution to this problem is to move this keys inward so that no hand adjustments have to made. This is a sort of
+ * mapping layer, but how do we activate this mapping layer?
+ *
+ * Clearly we want to adhere to the principle of not moving your hand and so we don't have the option of enabling this
+ * mapping mode with traditional keys like ctrl/alt/super etc so instead we have to try something new.
+ *
+ * Space is the biggest key on the keyboard and pressed by the strongest finger on your hand, so leveraging this key
+ * would be good, simply mapping space to activate the mapping mode would be bad, because we use space for other thing
+ * as well.
+ *
+ * One area that we can take advantage of is timing. If we get the user to press space in fast succession we'll enable
+ * the mapping layer, if the second space is not emitted within the time frame then we can the mode is not activated,
+ * and if you press any key other than space after hitting space, then the mod will also not be activated. This keeps
+ * the regular behavior while adding the mapping layer if you know the timing and go fast.
+ *
+ * TLDR:
+ *
+ * space tap, space hold in fast succession activates the mapping mode, in this mode, certain keys are remapped to other
+ * keys
+ *
+ * when space is released the mapping mode turns off and keys go back to their regular function unless the following is
+ * true
+ *
+ * if a key is remapped by the mode and it is continually held down even when space is released then it continues to
+ * repeat the mapped key.
+ *
+ * the purpose of this extra functionality is to allow you to combine mapped and unmapped keys, so for example if / is
+ * mapped to right shift in the mapped state and a is mapped to escape in the mapped state, then it's impossible to type
+ * shift-a in the mapped state because a is already being mapped to something. In order to allow for such situation we
+ * need to be able to conditionally keep mapped keys active, and to do this we use above method. In this way we can
+ * activate the mapping mode, and then hold down / to keep shift active
+ *
+ * TODO: another feature that I want to add is the ability to do punch through toggling, what this means is that you hit
+ * space space to enter the mode, and while this is active there should be a way to temporarliy just toggle the mode so
+ * maybe akey where you press it down nd it will temporarily disable the mapping mode.
+ *
+ * the point is that you can type things like this_thing_here, without having to spam space so much
+ *
+ */
+// TODO: this needs to be renamed, and then the one with these specific mappings is the homebody keyboard mappings
+class ChordSystem {
+
+  public:
+    // NOTE: defined alongside the built-in layers so their tables can say which layer they are
+    using MapName = static_layers::MapName;
+
+    struct KeyMap {
+        MapName map_name;
+        // the layer's table, one of the constexpr tables of static_layers for every layer but shift_lock
+        std::span<const static_layers::KeyMapping> key_mappings;
+        // indexed like key_mappings, whether each mapping is currently active
+        std::vector<bool> active;
+
+        void set_key_mappings(std::span<const static_layers::KeyMapping> key_mappings) {
+            this->key_mappings = key_mappings;
+            active.assign(key_mappings.size(), false);
+        }
+    };
+
+    // indexed by MapName
+    std::array<KeyMap, static_layers::num_map_names> key_maps;
+    KeyMap &get_key_map(MapName map_name) { return key_maps[static_cast<size_t>(map_name)]; }
+
+    MapName current_mapping = MapName::homesick;
+
+    SimultaneousKeypresses simultaneous_keypresses{std::chrono::milliseconds(35), key_interceptor};
+
+    // interactively asks which device to intercept and creates the virtual keyboard
+    ChordSystem();
+    ChordSystem(const std::string &device_name, int virtual_keyboard_file_descriptor, bool exclusive_control);
+    // a pipeline without devices, eg fed from an InMemoryInputSource
+    ChordSystem(std::unique_ptr<InputSource> input_source, std::unique_ptr<OutputSink> output_sink);
+
+    KeyInterceptor key_interceptor;
+    // the keys of the intercepted keyboard, owned by key_interceptor so several chord systems can run side by side
+    InputState &input_state = key_interceptor.input_state;
+
+    MouseKeys mouse_keys;
+    // vim style, with u and n scrolling up and down
+    const std::vector<EKey> mouse_keys_movement_keys = {EKey::h, EKey::j, EKey::k, EKey::l, EKey::u, EKey::n};
+    // movement keys pressed while the layer was active, they are kept away from the virtual keyboard until released
+    // even if the layer turns off first
+    std::vector<EKey> mouse_keys_movement_keys_in_use;
+
+    bool timer_started_at_least_once = false;
+    static constexpr std::chrono::milliseconds mapping_mode_activation_window{200};
+    Timer mapping_mode_activation_timer{std::chrono::duration<double>(mapping_mode_activation_window).count()};
+    // when mapping_mode_activation_timer runs out, so a loop that sleeps while idle knows when to wake up for it
+    std::chrono::steady_clock::time_point mapping_mode_activation_deadline;
+
+    bool mapping_mode_active = false;
+    EKey key_used_to_start_mapping;
+
+    bool possibly_going_into_mapping_mode = false;
+
+    bool logging_enabled = false;
+
+    bool space_tap_mapping_activation_mode = false;
+
+    /**
+     * @brief in the space tap activation mode a space is normally held back until either the activation window is
+     * over or another key is pressed, which delays every ordinary space. When this is on the space is sent right away
+     * instead, and if a second space comes within the window it is taken back by tapping speculative_space_undo_keys
+     * before the layer turns on.
+     *
+     * NOTE: the undo only works where backspace deletes the last character, speculative_space_paused turns it off
+     * for the applications where it doesn't (eg a terminal running vim in normal mode)
+     */
+    bool speculative_space = false;
+    bool speculative_space_paused = false;
+    // pressed in order and released in reverse, eg {EKey::LEFT_CONTROL, EKey::z}
+    std::vector<EKey> speculative_space_undo_keys = {EKey::BACKSPACE};
+    // a space was sent speculatively and the window in which it can still be taken back isn't over
+    bool speculative_space_sent = false;
+    void retract_speculative_space();
+
+    std::chrono::steady_clock::time_point space_pressed_time;
+    std::chrono::steady_clock::time_point f_pressed_time;
+
+    // shift_lock's table, derived from the shiftable keys of input_state once at startup
+    std::vector<static_layers::KeyMapping> shift_lock_key_mappings;
+
+    // points the key maps at the built-in layers and registers the mapping combos, shared by the constructors
+    void initialize_key_maps();
+
+    // what a combo does when it fires is read from its entry in static_layers::mapping_combos, the combo index is its
+    // position there
+    void activate_mapping(const static_layers::MappingCombo &mapping_combo);
+
+    // optional, when set layer, combo and remapped key usage is counted
+    UsageStatistics *usage_statistics = nullptr;
+    void set_usage_statistics(UsageStatistics *usage_statistics);
+
+    // optional, when set the threshold of every mapping combo is learned from how it's typed
+    ComboThresholdLearner *combo_threshold_learner = nullptr;
+    void set_combo_threshold_learner(ComboThresholdLearner *combo_threshold_learner);
+
+    // optional, when set the state is published for key_interceptor_viewer by publish_state_snapshot
+    StateSnapshotPublisher *state_snapshot_publisher = nullptr;
+    void set_state_snapshot_publisher(StateSnapshotPublisher *state_snapshot_publisher);
+
+    state_snapshot::Snapshot get_state_snapshot() const;
+    // call after the key interceptor has updated so the virtual keyboard reflects what was just sent
+    void publish_state_snapshot();
+
+    void per_iteration_logic();
+
+    /**
+     * @brief how long the logic can go without running before one of its timers is missed (the delayed space of the
+     * space tap activation mode, a debounced key that has to settle), at most max_timeout_ms
+     */
+    int get_idle_timeout_ms(int max_timeout_ms) const;
+
+    void update_mouse_keys();
+    void send_mouse_keys_motion();
+};
+
+std::string to_string(ChordSystem::MapName map_name);
+
+#endif // CHORD_SYSTEM_HPP
@@ -0,0 +1,156 @@
+#include "combo_threshold_learner.hpp"
+
+#include "utility/logger/logger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+ComboThresholdLearner::ComboThresholdLearner(const std::string &path) : path(path) {
+    std::ifstream file(path);
+    if (not file)
+        return;
+
+    // NOTE: one line per key pair: both linux codes, "chords" and its buckets, then "rolls" and its buckets
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() or line[0] == '#')
+            continue;
+
+        std::istringstream stream(line);
+        int key1_linux_code, key2_linux_code;
+        std::string chords_label, rolls_label;
+        GapHistograms gap_histograms;
+
+        stream >> key1_linux_code >> key2_linux_code >> chords_label;
+        for (uint32_t &count : gap_histograms.chords)
+            stream >> count;
+        stream >> rolls_label;
+        for (uint32_t &count : gap_histograms.rolls)
+            stream >> count;
+
+        if (not stream or chords_label != "chords" or rolls_label != "rolls") {
+            global_logger->warn("skipping a malformed line in {}", path);
+            continue;
+        }
+        key_pair_to_gap_histograms[get_key_pair(key1_linux_code, key2_linux_code)] = gap_histograms;
+    }
+}
+
+void ComboThresholdLearner::set_combo(size_t combo_index, int key1_linux_code, int key2_linux_code) {
+    if (combo_index >= combo_gap_histograms.size())
+        combo_gap_histograms.resize(combo_index + 1, nullptr);
+    combo_gap_histograms[combo_index] = &key_pair_to_gap_histograms[get_key_pair(key1_linux_code, key2_linux_code)];
+}
+
+void ComboThresholdLearner::record(size_t combo_index, std::chrono::milliseconds gap,
+                                   std::chrono::milliseconds overlap) {
+    if (combo_index >= combo_gap_histograms.size() or combo_gap_histograms[combo_index] == nullptr)
+        return;
+
+    // NOTE: a gap this long is neither a chord nor a roll that any threshold we'd learn could tell apart, and clamped
+    // into the last bucket it would count as a chord just past max_threshold
+    if (gap.count() < 0 or gap.count() >= static_cast<int64_t>(num_gap_buckets))
+        return;
+
+    GapHistograms &gap_histograms = *combo_gap_histograms[combo_index];
+    size_t bucket = gap.count();
+    if (overlap >= min_chord_overlap)
+        gap_histograms.chords[bucket]++;
+    else
+        gap_histograms.rolls[bucket]++;
+    recorded_since_last_save = true;
+}
+
+std::optional<std::chrono::milliseconds> ComboThresholdLearner::get_learned_threshold(size_t combo_index) const {
+    if (combo_index >= combo_gap_histograms.size() or combo_gap_histograms[combo_index] == nullptr)
+        return std::nullopt;
+
+    const GapHistograms &gap_histograms = *combo_gap_histograms[combo_index];
+    uint32_t num_chords = 0;
+    for (uint32_t count : gap_histograms.chords)
+        num_chords += count;
+    if (num_chords < min_num_chords)
+        return std::nullopt;
+
+    // with a threshold of t, chords with a gap of t or more don't fire and rolls with a gap below t misfire
+    std::array<uint32_t, num_gap_buckets + 1> num_misclassified;
+    num_misclassified[0] = num_chords;
+    for (size_t t = 1; t <= num_gap_buckets; t++)
+        num_misclassified[t] = num_misclassified[t - 1] - gap_histograms.chords[t - 1] + gap_histograms.rolls[t - 1];
+
+    // NOTE: the tightest threshold within 1% of the chords of the fewest mistakes, so a single slow chord doesn't
+    // loosen the threshold for everything else. Only thresholds up to max_threshold are considered.
+    size_t max_threshold_ms = max_threshold.count();
+    uint32_t fewest_misclassified =
+        *std::min_element(num_misclassified.begin(), num_misclassified.begin() + max_threshold_ms + 1);
+    uint32_t tolerance = num_chords / 100;
+    size_t threshold_ms = 0;
+    while (num_misclassified[threshold_ms] > fewest_misclassified + tolerance)
+        threshold_ms++;
+
+    return std::max(std::chrono::milliseconds(threshold_ms), min_threshold);
+}
+
+ComboThresholdLearner::~ComboThresholdLearner() {
+    if (saving_thread.joinable())
+        saving_thread.join();
+}
+
+bool ComboThresholdLearner::save() {
+    if (saving_thread.joinable())
+        saving_thread.join();
+
+    recorded_since_last_save = false;
+    last_save_time = std::chrono::steady_clock::now();
+    return write(path, key_pair_to_gap_histograms);
+}
+
+void ComboThresholdLearner::save_if_due() {
+    if (not recorded_since_last_save or std::chrono::steady_clock::now() - last_save_time < save_interval)
+        return;
+    // the last save is still being written, it's tried again on the next call
+    if (saving.load(std::memory_order_acquire))
+        return;
+
+    if (saving_thread.joinable())
+        saving_thread.join();
+
+    recorded_since_last_save = false;
+    last_save_time = std::chrono::steady_clock::now();
+    saving.store(true, std::memory_order_relaxed);
+    saving_thread = std::thread([this, key_pair_to_gap_histograms = key_pair_to_gap_histograms]() {
+        write(path, key_pair_to_gap_histograms);
+        saving.store(false, std::memory_order_release);
+    });
+}
+
+bool ComboThresholdLearner::write(const std::string &path, const KeyPairToGapHistograms &key_pair_to_gap_histograms) {
+    std::string temporary_path = path + ".tmp";
+    std::ofstream file(temporary_path);
+    if (not file) {
+        global_logger->warn("couldn't write the combo timings to {}", path);
+        return false;
+    }
+
+    file << "# key_interceptor combo timings: linux codes of the two keys, then the gaps between their presses in 1ms "
+            "buckets for chords and for rolls\n";
+    for (const auto &[key_pair, gap_histograms] : key_pair_to_gap_histograms) {
+        file << key_pair.first << " " << key_pair.second << " chords";
+        for (uint32_t count : gap_histograms.chords)
+            file << " " << count;
+        file << " rolls";
+        for (uint32_t count : gap_histograms.rolls)
+            file << " " << count;
+        file << "\n";
+    }
+
+    file.close();
+    if (not file or std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        global_logger->warn("couldn't write the combo timings to {}", path);
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef COMBO_THRESHOLD_LEARNER_HPP
+#define COMBO_THRESHOLD_LEARNER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief learns a threshold per combo from how you actually type its two keys. Every time both keys of a combo were
+ * down together the gap between their presses is put in one of two histograms: chords, where the keys then stayed down
+ * together (eg space held to use a layer), and rolls, where the first key came back up soon after the second went down
+ * (eg typing "a " quickly). The learned threshold is the tightest one that still separates the two.
+ *
+ * The histograms are kept per pair of linux codes in a text file, so learning carries over across runs and combos.
+ */
+class ComboThresholdLearner {
+  public:
+    // one bucket per millisecond of gap, longer gaps aren't recorded as no threshold that long is ever learned
+    static constexpr size_t num_gap_buckets = 128;
+    // fewer chords than this and the combo keeps the threshold it had
+    static constexpr uint32_t min_num_chords = 20;
+    // keys that stay down together at least this long after the second press were meant as a chord
+    static constexpr std::chrono::milliseconds min_chord_overlap{80};
+    static constexpr std::chrono::milliseconds min_threshold{5};
+    // NOTE: past this ordinary rolls start firing combos no matter what was learned, so a few very slow chords can't
+    // loosen a combo that far
+    static constexpr std::chrono::milliseconds max_threshold{60};
+    // how often save_if_due writes, a crash or a kill loses at most this much of what was learned
+    static constexpr std::chrono::minutes save_interval{5};
+    static constexpr const char *default_path = "combo_timings.txt";
+
+    // loads what was learned in earlier runs, a missing file starts from nothing
+    explicit ComboThresholdLearner(const std::string &path);
+    ~ComboThresholdLearner();
+
+    ComboThresholdLearner(const ComboThresholdLearner &) = delete;
+    ComboThresholdLearner &operator=(const ComboThresholdLearner &) = delete;
+
+    // the combo that process reports as combo_index, called once per combo at startup
+    void set_combo(size_t combo_index, int key1_linux_code, int key2_linux_code);
+
+    // gap between the presses of the two keys and how long both were down together after the second press
+    void record(size_t combo_index, std::chrono::milliseconds gap, std::chrono::milliseconds overlap);
+
+    // empty until the combo has enough chords to go on
+    std::optional<std::chrono::milliseconds> get_learned_threshold(size_t combo_index) const;
+
+    // writes everything learned so far back to the file, returns false if it couldn't be written
+    bool save();
+
+    /**
+     * @brief call regularly from the thread that records, once save_interval has passed since the last save and
+     * something was recorded it writes what was learned on a thread of its own so the caller never waits on the disk
+     */
+    void save_if_due();
+
+  private:
+    struct GapHistograms {
+        std::array<uint32_t, num_gap_buckets> chords{};
+        std::array<uint32_t, num_gap_buckets> rolls{};
+    };
+    using KeyPairToGapHistograms = std::map<std::pair<int, int>, GapHistograms>;
+
+    // NOTE: written next to the file and renamed over it, so a crash while writing never leaves half a file
+    static bool write(const std::string &path, const KeyPairToGapHistograms &key_pair_to_gap_histograms);
+
+    // NOTE: the pair is ordered so that space + a and a + space share their timings
+    static std::pair<int, int> get_key_pair(int key1_linux_code, int key2_linux_code) {
+        return std::minmax(key1_linux_code, key2_linux_code);
+    }
+
+    std::string path;
+    KeyPairToGapHistograms key_pair_to_gap_histograms;
+    // indexed by combo index, points into key_pair_to_gap_histograms which never moves its elements
+    std::vector<GapHistograms *> combo_gap_histograms;
+
+    bool recorded_since_last_save = false;
+    std::chrono::steady_clock::time_point last_save_time = std::chrono::steady_clock::now();
+    // writes a copy of the histograms, so recording goes on while it runs
+    std::thread saving_thread;
+    std::atomic<bool> saving = false;
+};
+
+#endif // COMBO_THRESHOLD_LEARNER_HPP
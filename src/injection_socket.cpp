@@ -0,0 +1,144 @@
+#include "injection_socket.hpp"
+
+#include "utility/logger/logger.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <grp.h>
+#include <iostream>
+#include <linux/input-event-codes.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace injection;
+
+InjectionSocket::InjectionSocket(const std::string &socket_path) : socket_path(socket_path) {
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "injection socket path is too long: " << socket_path << "\n";
+        return;
+    }
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    file_descriptor = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (file_descriptor < 0) {
+        perror("socket injection");
+        return;
+    }
+
+    // NOTE: a socket left behind by a previous run that didn't exit cleanly is removed, anything else at the path is
+    // left alone, the interceptor usually runs as root and the path is often in /tmp
+    struct stat existing;
+    if (lstat(socket_path.c_str(), &existing) == 0) {
+        if (not S_ISSOCK(existing.st_mode)) {
+            std::cerr << "not replacing " << socket_path << " with the injection socket, it isn't a socket\n";
+            close(file_descriptor);
+            file_descriptor = -1;
+            return;
+        }
+        unlink(socket_path.c_str());
+    }
+
+    // NOTE: created with no permissions for anyone else from the start, chmod after bind would leave a window
+    mode_t previous_umask = umask(0077);
+    int bind_result = bind(file_descriptor, reinterpret_cast<struct sockaddr *>(&address), sizeof(address));
+    umask(previous_umask);
+
+    if (bind_result < 0) {
+        perror("bind injection socket");
+        close(file_descriptor);
+        file_descriptor = -1;
+    }
+}
+
+bool InjectionSocket::allow_group(const std::string &group_name) {
+    if (file_descriptor < 0)
+        return false;
+
+    struct group *group = getgrnam(group_name.c_str());
+    if (group == nullptr) {
+        std::cerr << "no group named " << group_name << " to give the injection socket to\n";
+        return false;
+    }
+
+    // NOTE: the socket was created 0600, so it only opens up here, once it belongs to the group
+    if (chown(socket_path.c_str(), -1, group->gr_gid) < 0 or chmod(socket_path.c_str(), 0660) < 0) {
+        perror("give the injection socket to its group");
+        return false;
+    }
+    return true;
+}
+
+InjectionSocket::~InjectionSocket() {
+    if (file_descriptor < 0)
+        return;
+
+    close(file_descriptor);
+    unlink(socket_path.c_str());
+}
+
+const char *InjectionSocket::validate_frame(const unsigned char *frame, size_t size) {
+    if (size < sizeof(FrameHeader))
+        return "shorter than the header";
+
+    FrameHeader header;
+    memcpy(&header, frame, sizeof(header));
+    if (header.magic != magic)
+        return "wrong magic";
+    if (header.version != version)
+        return "unsupported version";
+    if (header.num_events == 0 or header.num_events > max_events_per_frame)
+        return "invalid number of events";
+    if (size != get_frame_size(header.num_events))
+        return "size doesn't match the number of events";
+
+    for (size_t i = 0; i < header.num_events; i++) {
+        KeyEvent event;
+        memcpy(&event, frame + get_frame_size(i), sizeof(event));
+        // the virtual keyboard supports every code below KEY_MAX, 0 is KEY_RESERVED
+        if (event.linux_code == 0 or event.linux_code >= KEY_MAX)
+            return "key code the virtual keyboard doesn't have";
+        if (event.value > 1)
+            return "value is neither a press nor a release";
+    }
+
+    return nullptr;
+}
+
+size_t InjectionSocket::receive(std::vector<KeyEvent> &events) {
+    if (file_descriptor < 0)
+        return 0;
+
+    // one byte more than the largest valid frame so that a larger one is seen as invalid instead of truncated to fit
+    unsigned char frame[max_frame_size + 1];
+    size_t num_frames = 0;
+    for (size_t i = 0; i < max_frames_per_receive; i++) {
+        ssize_t size = recv(file_descriptor, frame, sizeof(frame), 0);
+        if (size < 0) {
+            if (errno != EAGAIN and errno != EWOULDBLOCK and errno != EINTR)
+                perror("recv injection socket");
+            break;
+        }
+
+        const char *problem = validate_frame(frame, size);
+        if (problem != nullptr) {
+            num_frames_rejected++;
+            global_logger->warn("rejected injected frame of {} bytes: {}", size, problem);
+            continue;
+        }
+
+        FrameHeader header;
+        memcpy(&header, frame, sizeof(header));
+        size_t first_new_event = events.size();
+        events.resize(first_new_event + header.num_events);
+        memcpy(events.data() + first_new_event, frame + sizeof(FrameHeader), header.num_events * sizeof(KeyEvent));
+
+        num_frames++;
+        num_frames_received++;
+    }
+
+    return num_frames;
+}
@@ -0,0 +1,88 @@
+#ifndef INJECTION_SOCKET_HPP
+#define INJECTION_SOCKET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief the format of the frames that other programs send to the injection socket to type through the virtual
+ * keyboard, it is shared with the key_interceptor_inject tool so this part of the header must stay plain data.
+ *
+ * A frame is one datagram holding a FrameHeader followed by num_events KeyEvents, which are sent in order and all in
+ * the same tick, so a frame can hold a whole macro (eg ctrl down, c down, c up, ctrl up). A frame that isn't valid is
+ * dropped as a whole.
+ */
+namespace injection {
+
+inline constexpr const char *default_socket_path = "/tmp/key_interceptor_injection.sock";
+inline constexpr uint32_t magic = 0x4b494a46; // "KIJF"
+inline constexpr uint16_t version = 1;
+
+inline constexpr size_t max_events_per_frame = 512;
+
+struct FrameHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_events;
+};
+
+struct KeyEvent {
+    uint16_t linux_code;
+    // 0 release, 1 press, repeats are left to the kernel
+    uint8_t value;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(FrameHeader) == 8 and sizeof(KeyEvent) == 4, "the frame layout is part of the protocol");
+
+inline constexpr size_t get_frame_size(size_t num_events) {
+    return sizeof(FrameHeader) + num_events * sizeof(KeyEvent);
+}
+inline constexpr size_t max_frame_size = get_frame_size(max_events_per_frame);
+
+} // namespace injection
+
+/**
+ * @brief the receiving end, a nonblocking unix datagram socket. The key interceptor drains it once per update and
+ * queues the events with everything else that update sends, so injected keys stay in order with live typing.
+ *
+ * NOTE: the socket is only accessible to the user the interceptor runs as (usually root) unless allow_group is called,
+ * anything that can write to it can type anything
+ */
+class InjectionSocket {
+  public:
+    explicit InjectionSocket(const std::string &socket_path = injection::default_socket_path);
+    ~InjectionSocket();
+
+    InjectionSocket(const InjectionSocket &) = delete;
+    InjectionSocket &operator=(const InjectionSocket &) = delete;
+
+    bool is_enabled() const { return file_descriptor >= 0; }
+
+    // lets the members of the group write to the socket as well, eg so scripts don't have to run as root
+    bool allow_group(const std::string &group_name);
+    int get_file_descriptor() const { return file_descriptor; }
+
+    // appends the events of every valid frame that is waiting (up to max_frames_per_receive) and returns how many
+    // frames that was
+    size_t receive(std::vector<injection::KeyEvent> &events);
+
+    size_t get_num_frames_received() const { return num_frames_received; }
+    size_t get_num_frames_rejected() const { return num_frames_rejected; }
+
+  private:
+    // bounds how long a single update can spend on injected input when a client floods the socket
+    static constexpr size_t max_frames_per_receive = 64;
+
+    std::string socket_path;
+    int file_descriptor = -1;
+    size_t num_frames_received = 0;
+    size_t num_frames_rejected = 0;
+
+    // returns the reason the frame is invalid or nullptr if it's fine
+    static const char *validate_frame(const unsigned char *frame, size_t size);
+};
+
+#endif // INJECTION_SOCKET_HPP
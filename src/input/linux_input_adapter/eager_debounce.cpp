@@ -0,0 +1,15 @@
+#include "eager_debounce.hpp"
+
+void EagerDebounce::reset(int linux_code, bool pressed) {
+    KeyState &key_state = key_states[linux_code];
+    key_state.window_end_us = 0;
+    key_state.raw_pressed = pressed;
+    keys_to_settle.set(linux_code, false);
+}
+
+void EagerDebounce::record_suppressed_bounce(int linux_code) {
+    key_states[linux_code].num_suppressed_bounces++;
+    total_num_suppressed_bounces++;
+    if (on_suppressed_bounce)
+        on_suppressed_bounce(linux_code);
+}
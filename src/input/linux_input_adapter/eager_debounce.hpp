@@ -0,0 +1,115 @@
+#ifndef EAGER_DEBOUNCE_HPP
+#define EAGER_DEBOUNCE_HPP
+
+#include "key_bitmap.hpp"
+
+#include <linux/input.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+/**
+ * @brief debounces chattering switches without delaying any keystroke: the first edge of a key is passed on right away
+ * and opens a window in which any further edges of that key are taken to be bounces and suppressed. If a key ends its
+ * window in another state than the one that was passed on (eg a real release that came within the window) that state is
+ * passed on by settle once the window is over.
+ *
+ * Times are the kernel's event timestamps in microseconds, so the window doesn't depend on when the events were read.
+ */
+class EagerDebounce {
+  public:
+    // a window of 0 turns debouncing off
+    void set_window(std::chrono::microseconds window) { window_us = window.count(); }
+    bool is_enabled() const { return window_us > 0; }
+
+    // optional, called with the linux code of every suppressed bounce, eg to count them in the usage statistics
+    std::function<void(int linux_code)> on_suppressed_bounce;
+
+    /**
+     * @brief pressed is the state the key went to at time_us and passed_on_pressed the state last passed on for it,
+     * returns whether this edge should be passed on
+     */
+    bool filter(int linux_code, bool pressed, bool passed_on_pressed, int64_t time_us) {
+        KeyState &key_state = key_states[linux_code];
+        key_state.raw_pressed = pressed;
+
+        if (time_us < key_state.window_end_us) {
+            record_suppressed_bounce(linux_code);
+            keys_to_settle.set(linux_code, pressed != passed_on_pressed);
+            return false;
+        }
+
+        keys_to_settle.set(linux_code, false);
+        if (pressed == passed_on_pressed)
+            return false;
+
+        key_state.window_end_us = time_us + window_us;
+        return true;
+    }
+
+    /**
+     * @brief calls on_settled(linux_code, pressed) for every key whose window is over by now_us and that ended it in a
+     * state that wasn't passed on. The settled edge counts as happening when the window ended and opens a window of its
+     * own from there. Returns whether any key was settled.
+     */
+    template <typename OnSettled> bool settle(int64_t now_us, OnSettled &&on_settled) {
+        if (not keys_to_settle.any())
+            return false;
+
+        bool any_settled = false;
+        keys_to_settle.for_each_set_key([&](int linux_code) {
+            KeyState &key_state = key_states[linux_code];
+            if (now_us < key_state.window_end_us)
+                return;
+
+            keys_to_settle.set(linux_code, false);
+            key_state.window_end_us += window_us;
+            on_settled(linux_code, key_state.raw_pressed);
+            any_settled = true;
+        });
+        return any_settled;
+    }
+
+    // the earliest time settle has something to do, empty while no key is waiting for its window to end
+    std::optional<int64_t> get_next_settle_time_us() const {
+        std::optional<int64_t> next_settle_time_us;
+        keys_to_settle.for_each_set_key([&](int linux_code) {
+            int64_t window_end_us = key_states[linux_code].window_end_us;
+            if (not next_settle_time_us.has_value() or window_end_us < *next_settle_time_us)
+                next_settle_time_us = window_end_us;
+        });
+        return next_settle_time_us;
+    }
+
+    // the key was set to pressed some other way, eg by a resync after SYN_DROPPED, so its window is dropped
+    void reset(int linux_code, bool pressed);
+
+    uint32_t get_num_suppressed_bounces(int linux_code) const { return key_states[linux_code].num_suppressed_bounces; }
+    uint64_t get_total_num_suppressed_bounces() const { return total_num_suppressed_bounces; }
+
+    // the kernel timestamp of the event, on whichever clock the device stamps its events with
+    static int64_t get_event_time_us(const struct input_event &ev) {
+        return static_cast<int64_t>(ev.input_event_sec) * 1'000'000 + ev.input_event_usec;
+    }
+
+  private:
+    void record_suppressed_bounce(int linux_code);
+
+    // NOTE: 16 bytes per key so the whole table is 12KB and a key's state is a single load
+    struct KeyState {
+        int64_t window_end_us = 0;
+        uint32_t num_suppressed_bounces = 0;
+        bool raw_pressed = false;
+    };
+
+    int64_t window_us = 0;
+    std::array<KeyState, KEY_CNT> key_states{};
+    // keys that ended up in another state than the one passed on while their window was open
+    KeyBitmap keys_to_settle;
+    uint64_t total_num_suppressed_bounces = 0;
+};
+
+#endif // EAGER_DEBOUNCE_HPP
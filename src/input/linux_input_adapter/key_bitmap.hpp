@@ -0,0 +1,88 @@
+#ifndef KEY_BITMAP_HPP
+#define KEY_BITMAP_HPP
+
+#include <linux/input-event-codes.h>
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief one bit per linux key code (KEY_CNT = 768 bits), for asking which keys are down without touching a Key object
+ * per key.
+ *
+ * NOTE: the operations loop over a fixed number of words with no branches so the compiler turns them into vector
+ * instructions on its own (eg 3 AVX2 ops for an AND), iterating the set bits only costs one countr_zero per set bit
+ */
+class KeyBitmap {
+  public:
+    static constexpr size_t num_words = (KEY_CNT + 63) / 64;
+
+    std::array<uint64_t, num_words> words{};
+
+    void set(int linux_code, bool pressed) {
+        uint64_t bit = uint64_t(1) << (linux_code % 64);
+        if (pressed)
+            words[linux_code / 64] |= bit;
+        else
+            words[linux_code / 64] &= ~bit;
+    }
+
+    bool test(int linux_code) const { return (words[linux_code / 64] >> (linux_code % 64)) & 1; }
+
+    bool any() const {
+        uint64_t combined = 0;
+        for (size_t i = 0; i < num_words; i++)
+            combined |= words[i];
+        return combined != 0;
+    }
+
+    void clear() { words.fill(0); }
+
+    KeyBitmap operator&(const KeyBitmap &other) const {
+        KeyBitmap result;
+        for (size_t i = 0; i < num_words; i++)
+            result.words[i] = words[i] & other.words[i];
+        return result;
+    }
+
+    // the keys in this bitmap that aren't in the other one
+    KeyBitmap and_not(const KeyBitmap &other) const {
+        KeyBitmap result;
+        for (size_t i = 0; i < num_words; i++)
+            result.words[i] = words[i] & ~other.words[i];
+        return result;
+    }
+
+    bool operator==(const KeyBitmap &other) const = default;
+
+    // calls f with the linux code of every set bit, in increasing order
+    template <typename F> void for_each_set_key(F &&f) const {
+        for (size_t i = 0; i < num_words; i++) {
+            uint64_t word = words[i];
+            while (word != 0) {
+                f(static_cast<int>(i * 64 + std::countr_zero(word)));
+                word &= word - 1;
+            }
+        }
+    }
+};
+
+/**
+ * @brief the bitmap equivalent of the pressed signals in InputState, set the current state while reading events and
+ * call process once at the end of the tick
+ */
+class KeyBitmapState {
+  public:
+    KeyBitmap current;
+    KeyBitmap previous;
+
+    KeyBitmap get_just_pressed() const { return current.and_not(previous); }
+    KeyBitmap get_just_released() const { return previous.and_not(current); }
+    KeyBitmap get_held() const { return current & previous; }
+
+    void process() { previous = current; }
+};
+
+#endif // KEY_BITMAP_HPP
@@ -1,6 +1,8 @@
 
 #include "linux_input_adapter.hpp"
 
+#include <algorithm>
+#include <ctime>
 #include <fcntl.h>
 #include <iostream>
 #include <linux/input-event-codes.h>
@@ -8,23 +10,7 @@
 #include <stdexcept>
 #include <unistd.h>
 
-LinuxInputAdapter::LinuxInputAdapter(InputState &input_state, const std::string &device_path, bool exclusive_control)
-    : input_state(input_state) {
-
-    fd = open(device_path.c_str(), O_RDONLY | O_NONBLOCK);
-    if (fd < 0) {
-        throw std::runtime_error("Failed to open input device: " + device_path);
-    }
-
-    // WARN: here we're grabbing the keyboard's input completely so that it will not go to any other program, this is
-    // only safe because we forward the keys in the main function, otherwise this could leave you in a state without any
-    // keyboard input.
-    if (exclusive_control) {
-        if (ioctl(fd, EVIOCGRAB, 1) < 0) {
-            perror("EVIOCGRAB");
-        }
-    }
-
+LinuxInputAdapter::LinuxInputAdapter(InputState &input_state) : input_state(input_state) {
     // Map Linux input codes to your EKey enum
     linux_code_to_key_enum.emplace(KEY_A, EKey::a);
     linux_code_to_key_enum.emplace(KEY_B, EKey::b);
@@ -112,14 +98,62 @@ LinuxInputAdapter::LinuxInputAdapter(InputState &input_state, const std::string
     linux_code_to_key_enum.emplace(BTN_MIDDLE, EKey::MIDDLE_MOUSE_BUTTON);
 }
 
+LinuxInputAdapter::LinuxInputAdapter(InputState &input_state, const std::string &device_path, bool exclusive_control)
+    : LinuxInputAdapter(input_state) {
+
+    fd = open(device_path.c_str(), O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open input device: " + device_path);
+    }
+
+    // WARN: here we're grabbing the keyboard's input completely so that it will not go to any other program, this is
+    // only safe because we forward the keys in the main function, otherwise this could leave you in a state without any
+    // keyboard input. If forwarding stalls the StallWatchdog gives the keyboard back, see stall_watchdog.hpp
+    if (exclusive_control)
+        set_exclusive_control(true);
+
+    // NOTE: by default evdev stamps events with CLOCK_REALTIME, which jumps around, with CLOCK_MONOTONIC the
+    // timestamps are on the same clock as std::chrono::steady_clock and can be compared with it
+    int clock_id = CLOCK_MONOTONIC;
+    event_times_are_monotonic = ioctl(fd, EVIOCSCLOCKID, &clock_id) == 0;
+}
+
 LinuxInputAdapter::~LinuxInputAdapter() {
     if (fd >= 0)
         close(fd);
 }
 
+bool LinuxInputAdapter::set_exclusive_control(bool exclusive_control) {
+    if (ioctl(fd, EVIOCGRAB, exclusive_control ? 1 : 0) < 0) {
+        perror("EVIOCGRAB");
+        return false;
+    }
+    return true;
+}
+
+bool LinuxInputAdapter::get_keys_down_in_kernel(KeyBitmap &keys_down) const {
+    // events that don't come from a device (see has_device) can't be resynced, there's nothing to ask
+    if (fd < 0)
+        return false;
+
+    unsigned long kernel_key_bitmap[(KEY_CNT + 8 * sizeof(unsigned long) - 1) / (8 * sizeof(unsigned long))] = {};
+    if (ioctl(fd, EVIOCGKEY(sizeof(kernel_key_bitmap)), kernel_key_bitmap) < 0) {
+        perror("EVIOCGKEY");
+        return false;
+    }
+
+    constexpr int bits_per_word = 8 * sizeof(unsigned long);
+    keys_down.clear();
+    for (int linux_code = 0; linux_code < KEY_CNT; linux_code++)
+        keys_down.set(linux_code, (kernel_key_bitmap[linux_code / bits_per_word] >> (linux_code % bits_per_word)) & 1);
+    return true;
+}
+
 void LinuxInputAdapter::poll_events() {
     GlobalLogSection _("poll_events");
-    struct input_event ev;
+    // NOTE: evdev only ever returns whole events, so reading a batch at once costs one syscall for a full burst of
+    // events (eg a 1000hz mouse) instead of one per event
+    struct input_event events[64];
 
     // Nonblocking
     // WARN: there is a period of time before the keyboard will report that it's being held down. Ie first you will
@@ -127,38 +161,169 @@ void LinuxInputAdapter::poll_events() {
     // will occur, and then you'll receive an event that the key is held ie ev.value is 2, because you these updates are
     // not instant it means that the pressed signal will not be getting updated on every tick, therefore we need to do
     // something
-    ssize_t n = read(fd, &ev, sizeof(ev));
-
-    while (n == sizeof(ev)) {
-        if (ev.type == EV_KEY) {
-            auto it = linux_code_to_key_enum.find(ev.code);
-            if (it != linux_code_to_key_enum.end()) {
-                Key &active_key = *(input_state.key_enum_to_object.at(it->second));
-                bool is_pressed = (ev.value != 0); // 0 = release, 1 = press, 2 = repeat
-                global_logger->debug("key detect: {} with value: {}", active_key.string_repr, ev.value);
-                active_key.pressed_signal.set(is_pressed);
-                global_logger->debug("pressed signal: {}", active_key.pressed_signal.to_string());
-            }
-        } else if (ev.type == EV_REL) {
-            // For relative mouse movement
-            if (ev.code == REL_X) {
-                input_state.prev_mouse_position_x = input_state.mouse_position_x;
-                input_state.mouse_position_x += ev.value;
-                input_state.mouse_delta_x = ev.value;
-            } else if (ev.code == REL_Y) {
-                input_state.prev_mouse_position_y = input_state.mouse_position_y;
-                input_state.mouse_position_y += ev.value;
-                input_state.mouse_delta_y = ev.value;
-            } else if (ev.code == REL_WHEEL) {
-                // Optional: handle scroll
-                // input_state.scroll_delta = ev.value;
-            }
-        }
+    ssize_t n = read(fd, events, sizeof(events));
 
-        n = read(fd, &ev, sizeof(ev));
+    while (n > 0) {
+        process_events(events, n / sizeof(struct input_event));
+        n = read(fd, events, sizeof(events));
     }
 
     if (n < 0 && errno != EAGAIN) {
         std::cerr << "Error reading from input device\n";
     }
+
+    settle_debounced_keys();
+}
+
+void LinuxInputAdapter::process_events(const struct input_event *events, size_t num_events) {
+    for (size_t i = 0; i < num_events; i++) {
+        process_event(events[i]);
+    }
+}
+
+void LinuxInputAdapter::process_event(const struct input_event &ev) {
+    // NOTE: when a client doesn't read fast enough (eg the process was descheduled under load) the kernel throws
+    // away the events in its buffer and reports SYN_DROPPED instead, the rest of that frame is incomplete so it's
+    // skipped and the real key state is fetched once the next frame starts, see the kernel's evdev docs
+    if (ev.type == EV_SYN and ev.code == SYN_DROPPED) {
+        global_logger->warn("events from the input device were dropped, resyncing on the next SYN_REPORT");
+        dropping_until_syn_report = true;
+        num_syn_dropped++;
+        relative_motion_of_current_frame = RelativeMotion();
+        current_frame_changed_a_key = false;
+        return;
+    }
+
+    if (dropping_until_syn_report) {
+        if (ev.type == EV_SYN and ev.code == SYN_REPORT) {
+            dropping_until_syn_report = false;
+            resync_key_state();
+        }
+        return;
+    }
+
+    if (ev.type == EV_KEY) {
+        auto it = linux_code_to_key_enum.find(ev.code);
+        if (it != linux_code_to_key_enum.end()) {
+            bool is_pressed = (ev.value != 0); // 0 = release, 1 = press, 2 = repeat
+
+            if (debounce.is_enabled()) {
+                int64_t event_time_us = EagerDebounce::get_event_time_us(ev);
+                // NOTE: keys whose window ran out before this event are settled first, this one's included
+                debounce.settle(event_time_us, [&](int linux_code, bool pressed) {
+                    set_key_pressed(linux_code, linux_code_to_key_enum.at(linux_code), pressed);
+                });
+                bool passed_on_pressed = key_bitmap_state.current.test(ev.code);
+
+                // a repeat isn't an edge, it's dropped while the press it repeats is being held back
+                bool passed_on = ev.value == repeat_value
+                                     ? passed_on_pressed
+                                     : debounce.filter(ev.code, is_pressed, passed_on_pressed, event_time_us);
+                if (not passed_on) {
+                    global_logger->debug("debounced: {} with value: {}", ev.code, ev.value);
+                    return;
+                }
+            }
+
+            if (key_bitmap_state.current.test(ev.code) != is_pressed)
+                current_frame_changed_a_key = true;
+            set_key_pressed(ev.code, it->second, is_pressed);
+        }
+    } else if (ev.type == EV_REL) {
+        // For relative mouse movement
+        if (ev.code == REL_X) {
+            input_state.prev_mouse_position_x = input_state.mouse_position_x;
+            input_state.mouse_position_x += ev.value;
+            input_state.mouse_delta_x = ev.value;
+            relative_motion_of_current_frame.x += ev.value;
+        } else if (ev.code == REL_Y) {
+            input_state.prev_mouse_position_y = input_state.mouse_position_y;
+            input_state.mouse_position_y += ev.value;
+            input_state.mouse_delta_y = ev.value;
+            relative_motion_of_current_frame.y += ev.value;
+        } else if (ev.code == REL_WHEEL) {
+            relative_motion_of_current_frame.wheel += ev.value;
+        } else if (ev.code == REL_HWHEEL) {
+            relative_motion_of_current_frame.hwheel += ev.value;
+        } else if (ev.code == REL_WHEEL_HI_RES) {
+            relative_motion_of_current_frame.wheel_hi_res += ev.value;
+        } else if (ev.code == REL_HWHEEL_HI_RES) {
+            relative_motion_of_current_frame.hwheel_hi_res += ev.value;
+        }
+    } else if (ev.type == EV_SYN and ev.code == SYN_REPORT) {
+        // NOTE: a frame is only forwarded once it is complete, a partially read frame stays in
+        // relative_motion_of_current_frame until the next poll
+        if (key_change_pending)
+            pending_relative_motion_after_key_change.add(relative_motion_of_current_frame);
+        else
+            pending_relative_motion.add(relative_motion_of_current_frame);
+        relative_motion_of_current_frame = RelativeMotion();
+
+        if (current_frame_changed_a_key)
+            key_change_pending = true;
+        current_frame_changed_a_key = false;
+    }
+}
+
+void LinuxInputAdapter::resync_key_state() {
+    KeyBitmap keys_down_in_kernel;
+    if (get_keys_down_in_kernel(keys_down_in_kernel))
+        resync_key_state(keys_down_in_kernel);
+}
+
+void LinuxInputAdapter::resync_key_state(const KeyBitmap &keys_down) {
+    int num_keys_changed = 0;
+    for (const auto &[linux_code, key_enum] : linux_code_to_key_enum) {
+        bool pressed = keys_down.test(linux_code);
+        if (input_state.is_pressed(key_enum) == pressed)
+            continue;
+
+        set_key_pressed(linux_code, key_enum, pressed);
+        num_keys_changed++;
+    }
+
+    // whatever the debounce was holding back is stale now
+    for (const auto &[linux_code, key_enum] : linux_code_to_key_enum)
+        debounce.reset(linux_code, keys_down.test(linux_code));
+
+    global_logger->warn("resynced key state, {} keys changed", num_keys_changed);
+}
+
+void LinuxInputAdapter::set_key_pressed(int linux_code, EKey key_enum, bool pressed) {
+    Key &active_key = *(input_state.key_enum_to_object.at(key_enum));
+    global_logger->debug("key detect: {} pressed: {}", active_key.string_repr, pressed);
+    active_key.pressed_signal.set(pressed);
+    key_bitmap_state.current.set(linux_code, pressed);
+    global_logger->debug("pressed signal: {}", active_key.pressed_signal.to_string());
+}
+
+bool LinuxInputAdapter::settle_debounced_keys() {
+    if (not debounce.is_enabled())
+        return false;
+
+    return debounce.settle(get_event_clock_now_us(), [&](int linux_code, bool pressed) {
+        set_key_pressed(linux_code, linux_code_to_key_enum.at(linux_code), pressed);
+    });
+}
+
+std::optional<std::chrono::microseconds> LinuxInputAdapter::get_time_until_next_settle() const {
+    std::optional<int64_t> next_settle_time_us = debounce.get_next_settle_time_us();
+    if (not next_settle_time_us.has_value())
+        return std::nullopt;
+    return std::chrono::microseconds(std::max<int64_t>(*next_settle_time_us - get_event_clock_now_us(), 0));
+}
+
+int64_t LinuxInputAdapter::get_event_clock_now_us() const {
+    // NOTE: the window was measured in event timestamps, so it has to run out on the clock the device stamps them with
+    struct timespec now;
+    clock_gettime(event_times_are_monotonic ? CLOCK_MONOTONIC : CLOCK_REALTIME, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1'000'000 + now.tv_nsec / 1000;
+}
+
+LinuxInputAdapter::RelativeMotion LinuxInputAdapter::take_relative_motion() {
+    RelativeMotion motion = pending_relative_motion;
+    pending_relative_motion = pending_relative_motion_after_key_change;
+    pending_relative_motion_after_key_change = RelativeMotion();
+    key_change_pending = false;
+    return motion;
 }
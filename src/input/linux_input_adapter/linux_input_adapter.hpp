@@ -1,9 +1,16 @@
 #ifndef LINUX_INPUT_ADAPTER_HPP
 #define LINUX_INPUT_ADAPTER_HPP
 
+#include <linux/input.h>
+
+#include <chrono>
+#include <optional>
 #include <string>
 #include <unordered_map>
 
+#include "eager_debounce.hpp"
+#include "key_bitmap.hpp"
+
 #include "sbpt_generated_includes.hpp"
 
 /**
@@ -15,17 +22,119 @@ class LinuxInputAdapter {
     static const int repeat_value = 2;
     std::unordered_map<int, EKey> linux_code_to_key_enum;
 
+    // the keys of linux_code_to_key_enum that are down, kept in step with the pressed signals of InputState
+    KeyBitmapState key_bitmap_state;
+
+    // off until it's given a window, the pressed signals and key_bitmap_state then only see debounced edges
+    EagerDebounce debounce;
+
+    /**
+     * @brief relative motion accumulated from EV_REL events, every axis is summed so that a burst of events (eg a
+     * 1000hz mouse) collapses into a single event per axis when it is forwarded
+     */
+    struct RelativeMotion {
+        int x = 0;
+        int y = 0;
+        int wheel = 0;
+        int hwheel = 0;
+        int wheel_hi_res = 0;
+        int hwheel_hi_res = 0;
+
+        bool empty() const {
+            return x == 0 and y == 0 and wheel == 0 and hwheel == 0 and wheel_hi_res == 0 and hwheel_hi_res == 0;
+        }
+
+        void add(const RelativeMotion &other) {
+            x += other.x;
+            y += other.y;
+            wheel += other.wheel;
+            hwheel += other.hwheel;
+            wheel_hi_res += other.wheel_hi_res;
+            hwheel_hi_res += other.hwheel_hi_res;
+        }
+    };
+
+    // without a device, the events are read some other way and handed to process_events
+    explicit LinuxInputAdapter(InputState &input_state);
     LinuxInputAdapter(InputState &input_state, const std::string &device_path, bool exclusive_control);
     ~LinuxInputAdapter();
 
+    bool has_device() const { return fd >= 0; }
+
+    // takes or gives back exclusive control of the device, returns false if the kernel refused
+    bool set_exclusive_control(bool exclusive_control);
+
+    // every key the kernel says is down on the device right now, returns false if it couldn't be asked
+    bool get_keys_down_in_kernel(KeyBitmap &keys_down) const;
+
+    /**
+     * @brief brings InputState back in line with the device, eg after events were dropped, by asking the kernel which
+     * keys are down right now. Only keys whose state actually differs are changed, so the next tick forwards just those
+     * differences as presses and releases.
+     */
+    void resync_key_state();
+    // the same with the keys that are down given, eg without a device to ask
+    void resync_key_state(const KeyBitmap &keys_down);
+
     // Poll the device for new events and update InputState
     void poll_events();
 
+    // updates InputState from events that were read from the device some other way
+    void process_events(const struct input_event *events, size_t num_events);
+
+    int get_file_descriptor() const { return fd; }
+
+    // true when the device stamps its events with CLOCK_MONOTONIC (see get_event_time), false eg for a pipe
+    bool has_monotonic_event_times() const { return event_times_are_monotonic; }
+
+    // the kernel timestamp of the event on the steady clock, only meaningful if has_monotonic_event_times
+    static std::chrono::steady_clock::time_point get_event_time(const struct input_event &ev) {
+        return std::chrono::steady_clock::time_point(std::chrono::seconds(ev.input_event_sec) +
+                                                     std::chrono::microseconds(ev.input_event_usec));
+    }
+
+    /**
+     * @brief passes on keys whose debounce window ran out in a state that wasn't passed on yet, call it after reading
+     * events. Returns whether any key changed.
+     */
+    bool settle_debounced_keys();
+
+    // how long until settle_debounced_keys has something to do, empty while there's nothing to settle
+    std::optional<std::chrono::microseconds> get_time_until_next_settle() const;
+
+    /**
+     * @brief returns the relative motion of the complete SYN frames read so far, up to and including the first frame
+     * that changed a key, and resets it. Motion of the frames after that one is kept for the next call, so forwarding
+     * motion, then the key changes, then motion again keeps a press, move, release in order.
+     */
+    RelativeMotion take_relative_motion();
+
+    // how many times the kernel's buffer for this device overflowed, each one was followed by a resync
+    size_t get_num_syn_dropped() const { return num_syn_dropped; }
+
   private:
+    // now on the clock the device stamps its events with, in microseconds
+    int64_t get_event_clock_now_us() const;
+
+    void process_event(const struct input_event &ev);
+
+    void set_key_pressed(int linux_code, EKey key_enum, bool pressed);
+
     InputState &input_state;
     int fd = -1;
+    bool event_times_are_monotonic = false;
+
+    // motion of the SYN frame currently being read, only committed once its SYN_REPORT arrives
+    RelativeMotion relative_motion_of_current_frame;
+    bool current_frame_changed_a_key = false;
+    RelativeMotion pending_relative_motion;
+    // set once a frame that changed a key is committed, the motion of later frames goes after that key change
+    bool key_change_pending = false;
+    RelativeMotion pending_relative_motion_after_key_change;
 
-    // mapping from linux evdev key/mouse codes to your ekey enum
+    // set by SYN_DROPPED, everything up to and including the next SYN_REPORT is discarded
+    bool dropping_until_syn_report = false;
+    size_t num_syn_dropped = 0;
 };
 
 #endif // LINUX_INPUT_ADAPTER_HPP
@@ -0,0 +1,311 @@
+#include "input_output_backend.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <unistd.h>
+
+#ifdef KEY_INTERCEPTOR_HAS_IO_URING
+#include <liburing.h>
+#endif
+
+size_t PollBackend::read_events(int file_descriptor, struct input_event *events, size_t max_events) {
+    ssize_t n = read(file_descriptor, events, max_events * sizeof(struct input_event));
+    if (n < 0) {
+        if (errno != EAGAIN)
+            std::cerr << "Error reading from input device\n";
+        return 0;
+    }
+    return n / sizeof(struct input_event);
+}
+
+bool PollBackend::wait_for_input(int timeout_ms) {
+    std::vector<struct pollfd> poll_file_descriptors;
+    for (int file_descriptor : input_file_descriptors)
+        poll_file_descriptors.push_back({file_descriptor, POLLIN, 0});
+
+    return poll(poll_file_descriptors.data(), poll_file_descriptors.size(), timeout_ms) > 0;
+}
+
+void PollBackend::write_events(int file_descriptor, const struct input_event *events, size_t num_events) {
+    auto &queued_events = file_descriptor_to_queued_events[file_descriptor];
+    queued_events.insert(queued_events.end(), events, events + num_events);
+}
+
+void PollBackend::flush() {
+    for (auto &[file_descriptor, queued_events] : file_descriptor_to_queued_events) {
+        if (queued_events.empty())
+            continue;
+
+        write(file_descriptor, queued_events.data(), queued_events.size() * sizeof(struct input_event));
+        queued_events.clear();
+    }
+}
+
+#ifdef KEY_INTERCEPTOR_HAS_IO_URING
+
+/**
+ * @brief keeps a multishot read posted on every input so reading costs no syscalls at all, completions are reaped
+ * straight from the completion queue. Writes go through the submission queue, one io_uring_enter per flush no matter
+ * how many devices were written to.
+ *
+ * NOTE: requires linux 6.7+ for multishot reads and liburing 2.5+
+ */
+class IoUringBackend : public InputOutputBackend {
+  public:
+    IoUringBackend() {
+        int result = io_uring_queue_init(queue_depth, &ring, 0);
+        if (result < 0) {
+            throw std::runtime_error(std::string("io_uring_queue_init failed: ") + strerror(-result));
+        }
+
+        read_buffer_storage.resize(num_read_buffers * events_per_read_buffer);
+        buffer_ring = io_uring_setup_buf_ring(&ring, num_read_buffers, read_buffer_group, 0, &result);
+        if (buffer_ring == nullptr) {
+            io_uring_queue_exit(&ring);
+            throw std::runtime_error(std::string("io_uring_setup_buf_ring failed: ") + strerror(-result));
+        }
+
+        for (unsigned short buffer_id = 0; buffer_id < num_read_buffers; buffer_id++)
+            return_read_buffer(buffer_id);
+    }
+
+    ~IoUringBackend() override {
+        io_uring_free_buf_ring(&ring, buffer_ring, num_read_buffers, read_buffer_group);
+        io_uring_queue_exit(&ring);
+    }
+
+    std::string get_name() const override { return "io_uring"; }
+
+    void add_input(int file_descriptor) override {
+        file_descriptor_to_staged_input[file_descriptor];
+        arm_multishot_read(file_descriptor);
+        io_uring_submit(&ring);
+    }
+
+    void add_wake_up_source(int file_descriptor) override {
+        arm_multishot_poll(file_descriptor);
+        io_uring_submit(&ring);
+    }
+
+    size_t read_events(int file_descriptor, struct input_event *events, size_t max_events) override {
+        reap_completions();
+
+        StagedInput &staged_input = file_descriptor_to_staged_input.at(file_descriptor);
+        size_t num_available = staged_input.events.size() - staged_input.num_consumed;
+        size_t num_to_copy = std::min(num_available, max_events);
+
+        memcpy(events, staged_input.events.data() + staged_input.num_consumed,
+               num_to_copy * sizeof(struct input_event));
+        staged_input.num_consumed += num_to_copy;
+
+        if (staged_input.num_consumed == staged_input.events.size()) {
+            staged_input.events.clear();
+            staged_input.num_consumed = 0;
+        }
+
+        return num_to_copy;
+    }
+
+    bool wait_for_input(int timeout_ms) override {
+        reap_completions();
+        for (const auto &[file_descriptor, staged_input] : file_descriptor_to_staged_input)
+            if (staged_input.events.size() > staged_input.num_consumed)
+                return true;
+
+        // NOTE: the completion is left in the queue for read_events to reap, a finished write also wakes this up early
+        struct __kernel_timespec timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1'000'000LL};
+        struct io_uring_cqe *cqe;
+        return io_uring_wait_cqe_timeout(&ring, &cqe, &timeout) == 0;
+    }
+
+    void write_events(int file_descriptor, const struct input_event *events, size_t num_events) override {
+        auto &queued_events = file_descriptor_to_output[file_descriptor].queued_events;
+        queued_events.insert(queued_events.end(), events, events + num_events);
+    }
+
+    void flush() override {
+        reap_completions();
+
+        bool submitted_any = false;
+        for (auto &[file_descriptor, output] : file_descriptor_to_output)
+            submitted_any |= submit_write(file_descriptor, output);
+
+        if (submitted_any)
+            io_uring_submit(&ring);
+    }
+
+  private:
+    static constexpr unsigned queue_depth = 64;
+    static constexpr unsigned num_read_buffers = 64;
+    static constexpr size_t events_per_read_buffer = 64;
+    static constexpr int read_buffer_group = 0;
+    // set in the user data of writes and wake up polls, the lower 32 bits always hold the file descriptor
+    static constexpr uint64_t write_tag = 1ull << 32;
+    static constexpr uint64_t poll_tag = 1ull << 33;
+
+    struct StagedInput {
+        std::vector<struct input_event> events;
+        size_t num_consumed = 0;
+    };
+
+    /**
+     * @brief only one write per device is ever in flight, otherwise the kernel is free to complete them out of order
+     * which would reorder keystrokes. Anything queued while a write is in flight goes out as soon as it completes.
+     */
+    struct Output {
+        std::vector<struct input_event> queued_events;
+        std::vector<struct input_event> in_flight_events;
+        bool write_in_flight = false;
+    };
+
+    struct io_uring ring;
+    struct io_uring_buf_ring *buffer_ring = nullptr;
+    std::vector<struct input_event> read_buffer_storage;
+
+    std::unordered_map<int, StagedInput> file_descriptor_to_staged_input;
+    std::unordered_map<int, Output> file_descriptor_to_output;
+
+    struct input_event *get_read_buffer(unsigned short buffer_id) {
+        return read_buffer_storage.data() + buffer_id * events_per_read_buffer;
+    }
+
+    void return_read_buffer(unsigned short buffer_id) {
+        io_uring_buf_ring_add(buffer_ring, get_read_buffer(buffer_id),
+                              events_per_read_buffer * sizeof(struct input_event), buffer_id,
+                              io_uring_buf_ring_mask(num_read_buffers), 0);
+        io_uring_buf_ring_advance(buffer_ring, 1);
+    }
+
+    /**
+     * @brief the submission queue fills up when several outputs and re-arms land in one reap, what's queued is then
+     * submitted to make room. Only returns nullptr if the kernel didn't take any of it.
+     */
+    struct io_uring_sqe *get_sqe() {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+        if (sqe != nullptr)
+            return sqe;
+
+        io_uring_submit(&ring);
+        return io_uring_get_sqe(&ring);
+    }
+
+    void arm_multishot_read(int file_descriptor) {
+        struct io_uring_sqe *sqe = get_sqe();
+        if (sqe == nullptr) {
+            std::cerr << "io_uring submission queue full, reading from " << file_descriptor << " stopped\n";
+            return;
+        }
+        io_uring_prep_read_multishot(sqe, file_descriptor, 0, 0, read_buffer_group);
+        io_uring_sqe_set_data64(sqe, static_cast<uint64_t>(file_descriptor));
+    }
+
+    // the completion only exists to wake up wait_for_input, it's dropped when reaped
+    void arm_multishot_poll(int file_descriptor) {
+        struct io_uring_sqe *sqe = get_sqe();
+        if (sqe == nullptr) {
+            std::cerr << "io_uring submission queue full, " << file_descriptor << " no longer wakes up the loop\n";
+            return;
+        }
+        io_uring_prep_poll_multishot(sqe, file_descriptor, POLLIN);
+        io_uring_sqe_set_data64(sqe, poll_tag | static_cast<uint32_t>(file_descriptor));
+    }
+
+    bool submit_write(int file_descriptor, Output &output) {
+        if (output.write_in_flight or output.queued_events.empty())
+            return false;
+
+        // NOTE: without an sqe the events stay queued and go out on the next flush
+        struct io_uring_sqe *sqe = get_sqe();
+        if (sqe == nullptr)
+            return false;
+
+        // the buffer has to stay alive until the write completes, so it's swapped out of the queue rather than copied
+        std::swap(output.in_flight_events, output.queued_events);
+        output.queued_events.clear();
+        output.write_in_flight = true;
+
+        io_uring_prep_write(sqe, file_descriptor, output.in_flight_events.data(),
+                            output.in_flight_events.size() * sizeof(struct input_event), 0);
+        io_uring_sqe_set_data64(sqe, write_tag | static_cast<uint32_t>(file_descriptor));
+        return true;
+    }
+
+    void reap_completions() {
+        bool needs_submit = false;
+        struct io_uring_cqe *cqe;
+
+        while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+            uint64_t user_data = io_uring_cqe_get_data64(cqe);
+            int file_descriptor = static_cast<int>(user_data & 0xffffffff);
+
+            if (user_data & write_tag) {
+                Output &output = file_descriptor_to_output.at(file_descriptor);
+                output.write_in_flight = false;
+                output.in_flight_events.clear();
+                if (cqe->res < 0)
+                    std::cerr << "io_uring write failed: " << strerror(-cqe->res) << "\n";
+
+                needs_submit |= submit_write(file_descriptor, output);
+            } else if (user_data & poll_tag) {
+                if (not(cqe->flags & IORING_CQE_F_MORE)) {
+                    arm_multishot_poll(file_descriptor);
+                    needs_submit = true;
+                }
+            } else {
+                if (cqe->res > 0 and (cqe->flags & IORING_CQE_F_BUFFER)) {
+                    unsigned short buffer_id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                    struct input_event *buffer = get_read_buffer(buffer_id);
+                    auto &staged_events = file_descriptor_to_staged_input.at(file_descriptor).events;
+                    staged_events.insert(staged_events.end(), buffer, buffer + cqe->res / sizeof(struct input_event));
+                    return_read_buffer(buffer_id);
+                }
+
+                // the kernel ends a multishot read when it runs out of buffers, it's reposted as they were just
+                // returned
+                if (not(cqe->flags & IORING_CQE_F_MORE)) {
+                    if (cqe->res >= 0 or cqe->res == -ENOBUFS) {
+                        arm_multishot_read(file_descriptor);
+                        needs_submit = true;
+                    } else {
+                        std::cerr << "io_uring read failed: " << strerror(-cqe->res) << "\n";
+                    }
+                }
+            }
+
+            io_uring_cqe_seen(&ring, cqe);
+        }
+
+        if (needs_submit)
+            io_uring_submit(&ring);
+    }
+};
+
+bool io_uring_backend_is_available() { return true; }
+
+#else
+
+bool io_uring_backend_is_available() { return false; }
+
+#endif
+
+std::unique_ptr<InputOutputBackend> create_input_output_backend(const std::string &name) {
+    if (name == "io_uring") {
+#ifdef KEY_INTERCEPTOR_HAS_IO_URING
+        try {
+            return std::make_unique<IoUringBackend>();
+        } catch (const std::runtime_error &e) {
+            std::cerr << e.what() << ", falling back to the poll backend\n";
+        }
+#else
+        std::cerr << "built without liburing, falling back to the poll backend\n";
+#endif
+    } else if (name != "poll") {
+        std::cerr << "unknown io backend: " << name << ", using the poll backend\n";
+    }
+
+    return std::make_unique<PollBackend>();
+}
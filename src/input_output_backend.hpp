@@ -0,0 +1,69 @@
+#ifndef INPUT_OUTPUT_BACKEND_HPP
+#define INPUT_OUTPUT_BACKEND_HPP
+
+#include <linux/input.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief how evdev events are read from the grabbed devices and written to the virtual device, chosen once at startup.
+ * Writes are only queued by write_events and are all handed to the kernel when flush is called, so every event a tick
+ * produces for a device goes out together.
+ */
+class InputOutputBackend {
+  public:
+    virtual ~InputOutputBackend() = default;
+
+    virtual std::string get_name() const = 0;
+
+    // must be called once for every descriptor that read_events will be called with
+    virtual void add_input(int file_descriptor) = 0;
+
+    // copies at most max_events events that are ready on the descriptor into events and never blocks, returns 0 once
+    // nothing is left
+    virtual size_t read_events(int file_descriptor, struct input_event *events, size_t max_events) = 0;
+
+    // wait_for_input also returns when this descriptor becomes readable, it's read by its owner and not through here
+    virtual void add_wake_up_source(int file_descriptor) = 0;
+
+    // blocks until one of the inputs has events to read or timeout_ms passes, returns false if it timed out
+    virtual bool wait_for_input(int timeout_ms) = 0;
+
+    virtual void write_events(int file_descriptor, const struct input_event *events, size_t num_events) = 0;
+    virtual void flush() = 0;
+};
+
+/**
+ * @brief the plain syscall backend, a nonblocking read per batch of up to max_events and a single write per device on
+ * every flush. Always available and used whenever io_uring isn't.
+ */
+class PollBackend : public InputOutputBackend {
+  public:
+    std::string get_name() const override { return "poll"; }
+    void add_input(int file_descriptor) override { input_file_descriptors.push_back(file_descriptor); }
+    void add_wake_up_source(int file_descriptor) override { input_file_descriptors.push_back(file_descriptor); }
+    size_t read_events(int file_descriptor, struct input_event *events, size_t max_events) override;
+    bool wait_for_input(int timeout_ms) override;
+    void write_events(int file_descriptor, const struct input_event *events, size_t num_events) override;
+    void flush() override;
+
+  private:
+    // everything wait_for_input polls, the inputs and the wake up sources
+    std::vector<int> input_file_descriptors;
+    std::unordered_map<int, std::vector<struct input_event>> file_descriptor_to_queued_events;
+};
+
+// returns true if this build can create an io_uring backend at all, it may still fail at runtime on older kernels
+bool io_uring_backend_is_available();
+
+/**
+ * @brief creates the backend with the given name ("poll" or "io_uring"), if io_uring is asked for but can't be set up
+ * the poll backend is returned instead
+ */
+std::unique_ptr<InputOutputBackend> create_input_output_backend(const std::string &name);
+
+#endif // INPUT_OUTPUT_BACKEND_HPP
@@ -0,0 +1,31 @@
+#include "input_source.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+EvdevInputSource::EvdevInputSource(InputOutputBackend &input_output_backend, int file_descriptor)
+    : input_output_backend(input_output_backend), file_descriptor(file_descriptor) {
+    input_output_backend.add_input(file_descriptor);
+}
+
+void InMemoryInputSource::push(const struct input_event *events, size_t num_events) {
+    {
+        std::lock_guard lock(mutex);
+        pending_events.insert(pending_events.end(), events, events + num_events);
+    }
+    events_pushed.notify_one();
+}
+
+size_t InMemoryInputSource::read_events(struct input_event *events, size_t max_events) {
+    std::lock_guard lock(mutex);
+    size_t num_to_copy = std::min(pending_events.size(), max_events);
+    std::copy_n(pending_events.begin(), num_to_copy, events);
+    pending_events.erase(pending_events.begin(), pending_events.begin() + num_to_copy);
+    return num_to_copy;
+}
+
+bool InMemoryInputSource::wait_for_input(int timeout_ms) {
+    std::unique_lock lock(mutex);
+    return events_pushed.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                  [this]() { return not pending_events.empty(); });
+}
@@ -0,0 +1,64 @@
+#ifndef INPUT_SOURCE_HPP
+#define INPUT_SOURCE_HPP
+
+#include "input_output_backend.hpp"
+
+#include <linux/input.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief where a key interceptor gets its evdev events from
+ */
+class InputSource {
+  public:
+    virtual ~InputSource() = default;
+
+    // copies at most max_events events that are ready into events and never blocks, returns 0 once nothing is left
+    virtual size_t read_events(struct input_event *events, size_t max_events) = 0;
+
+    // blocks until there are events to read or timeout_ms passes, returns false if it timed out
+    virtual bool wait_for_input(int timeout_ms) = 0;
+};
+
+/**
+ * @brief an evdev device (or anything else that reads like one, eg a pipe) read through an InputOutputBackend
+ */
+class EvdevInputSource : public InputSource {
+  public:
+    // the backend must outlive the source
+    EvdevInputSource(InputOutputBackend &input_output_backend, int file_descriptor);
+
+    size_t read_events(struct input_event *events, size_t max_events) override {
+        return input_output_backend.read_events(file_descriptor, events, max_events);
+    }
+    bool wait_for_input(int timeout_ms) override { return input_output_backend.wait_for_input(timeout_ms); }
+
+  private:
+    InputOutputBackend &input_output_backend;
+    int file_descriptor;
+};
+
+/**
+ * @brief events handed over in memory, eg by a program embedding the interceptor or by a benchmark. push may be called
+ * from any thread.
+ */
+class InMemoryInputSource : public InputSource {
+  public:
+    void push(const struct input_event *events, size_t num_events);
+    void push(const std::vector<struct input_event> &events) { push(events.data(), events.size()); }
+
+    size_t read_events(struct input_event *events, size_t max_events) override;
+    bool wait_for_input(int timeout_ms) override;
+
+  private:
+    std::mutex mutex;
+    std::condition_variable events_pushed;
+    std::deque<struct input_event> pending_events;
+};
+
+#endif // INPUT_SOURCE_HPP
@@ -0,0 +1,364 @@
+#include "key_interceptor.hpp"
+
+#include "select_linux_device.hpp"
+
+#include "utility/collection_utils/collection_utils.hpp"
+#include "utility/logger/logger.hpp"
+
+#include <iostream>
+
+KeyInterceptor::KeyInterceptor(std::function<void()> logic)
+    : KeyInterceptor(std::move(logic), interactively_select_linux_device_name(), create_virtual_keyboard_device(),
+                     true) {}
+
+KeyInterceptor::KeyInterceptor(std::function<void()> logic, const std::string &device_name,
+                               int virtual_keyboard_file_descriptor, bool exclusive_control)
+    : logic(std::move(logic)), device_name(device_name),
+      virtual_keyboard_file_descriptor(virtual_keyboard_file_descriptor),
+      linux_input_adapter(input_state, device_name, exclusive_control) {
+    initialize_key_enum_to_linux_code();
+    set_input_output_backend(std::make_unique<PollBackend>());
+}
+
+KeyInterceptor::KeyInterceptor(std::function<void()> logic, std::unique_ptr<InputSource> input_source,
+                               std::unique_ptr<OutputSink> output_sink)
+    : logic(std::move(logic)), linux_input_adapter(input_state), input_output_backend(std::make_unique<PollBackend>()),
+      input_source(std::move(input_source)), output_sink(std::move(output_sink)) {
+    initialize_key_enum_to_linux_code();
+}
+
+void KeyInterceptor::initialize_key_enum_to_linux_code() {
+    key_enum_to_linux_code = collection_utils::invert(linux_input_adapter.linux_code_to_key_enum);
+
+    // NOTE: the reason why this is here is because for some reason just sending over KEY_ENTER to the virtual
+    // keyboard doesn't work properly, and this fixes it and I don't exactly know why.
+    key_enum_to_linux_code.at(EKey::ENTER) = KEY_KPENTER;
+}
+
+void KeyInterceptor::set_input_output_backend(std::unique_ptr<InputOutputBackend> backend) {
+    input_output_backend = std::move(backend);
+    for (int file_descriptor : wake_up_file_descriptors)
+        input_output_backend->add_wake_up_source(file_descriptor);
+    if (not linux_input_adapter.has_device())
+        return;
+
+    input_source = std::make_unique<EvdevInputSource>(*input_output_backend, linux_input_adapter.get_file_descriptor());
+    output_sink = std::make_unique<UinputOutputSink>(*input_output_backend, virtual_keyboard_file_descriptor);
+}
+
+bool KeyInterceptor::wait_for_input(int timeout_ms) { return input_source->wait_for_input(timeout_ms); }
+
+void KeyInterceptor::add_wake_up_source(int file_descriptor) {
+    // NOTE: only a source read through the backend wakes up for it, otherwise it's still read on every update
+    wake_up_file_descriptors.push_back(file_descriptor);
+    input_output_backend->add_wake_up_source(file_descriptor);
+}
+
+void KeyInterceptor::set_injection_socket(InjectionSocket *injection_socket) {
+    this->injection_socket = injection_socket;
+    if (injection_socket != nullptr and injection_socket->is_enabled())
+        add_wake_up_source(injection_socket->get_file_descriptor());
+}
+
+void KeyInterceptor::set_stall_watchdog(StallWatchdog *stall_watchdog) { this->stall_watchdog = stall_watchdog; }
+
+bool KeyInterceptor::check_in_with_stall_watchdog() {
+    if (stall_watchdog == nullptr or not stall_watchdog->beat())
+        return true;
+
+    // NOTE: read straight from the source, these events are neither traced nor measured
+    struct input_event events[64];
+    while (input_source->read_events(events, 64) > 0) {
+    }
+
+    // NOTE: without a device nothing was handed to the os and there's nothing to ask, everything read in the meantime
+    // was thrown away above so every key counts as up
+    KeyBitmap keys_down;
+    if (linux_input_adapter.has_device() and
+        (not linux_input_adapter.get_keys_down_in_kernel(keys_down) or keys_down.any()))
+        return false;
+
+    // the watchdog released what was held when it fired, this catches anything sent while it was doing that and, as
+    // its releases went around the output sink, anything the sink still had in flight and delivered after them
+    KeyBitmap keys_to_release = virtual_keys;
+    stall_watchdog->get_held_keys().for_each_set_key([&](int linux_code) { keys_to_release.set(linux_code, true); });
+    keys_to_release.for_each_set_key([&](int linux_code) { queue_key(linux_code, LinuxInputAdapter::release_value); });
+    flush_output();
+
+    if (linux_input_adapter.has_device())
+        linux_input_adapter.set_exclusive_control(true);
+    linux_input_adapter.resync_key_state(keys_down);
+    stall_watchdog->keyboard_regrabbed();
+    global_logger->warn("the input loop recovered, the keyboard is grabbed again");
+    return true;
+}
+
+void KeyInterceptor::set_latency_measurement(LatencyMeasurement *latency_measurement) {
+    this->latency_measurement = latency_measurement;
+    if (latency_measurement != nullptr and not linux_input_adapter.has_monotonic_event_times())
+        std::cerr << "the keyboard doesn't stamp its events with CLOCK_MONOTONIC, measured latencies will be wrong\n";
+}
+
+void KeyInterceptor::poll_events() {
+    GlobalLogSection _("poll_events", logging_enabled);
+    TraceScope trace_scope("poll_events");
+
+    struct input_event events[64];
+    size_t num_events;
+    while ((num_events = read_events(events, 64)) > 0)
+        linux_input_adapter.process_events(events, num_events);
+    linux_input_adapter.settle_debounced_keys();
+}
+
+void KeyInterceptor::queue_key(int linux_code, int value) {
+    struct input_event events[2] = {};
+    events[0].type = EV_KEY;
+    events[0].code = linux_code;
+    events[0].value = value;
+    events[1].type = EV_SYN;
+    events[1].code = SYN_REPORT;
+    events[1].value = 0;
+    output_sink->write_events(events, 2);
+    virtual_keys.set(linux_code, value != LinuxInputAdapter::release_value);
+    if (stall_watchdog != nullptr)
+        stall_watchdog->note_key_sent(linux_code, value);
+
+    if (latency_measurement != nullptr and not queuing_injected_events) {
+        if (forwarding_linux_code >= 0)
+            latency_measurement->expect(linux_code, value, key_event_times[forwarding_linux_code],
+                                        LatencyMeasurement::Path::forwarded);
+        else
+            latency_measurement->expect(linux_code, value, last_key_event_time, LatencyMeasurement::Path::generated);
+    }
+}
+
+void KeyInterceptor::send_key_to_virtual_keyboard(EKey key_enum, int press_value) {
+
+    bool pressed = press_value > 0;
+
+    Key &active_key = *(virtual_input_state.key_enum_to_object.at(key_enum));
+    if (active_key.requires_modifer_to_be_typed) {
+
+        Key &active_key_unshifted =
+            *(virtual_input_state.key_enum_to_object.at(active_key.key_enum_of_unshifted_version));
+        Key &shift_key = *(virtual_input_state.key_enum_to_object.at(EKey::LEFT_SHIFT));
+        // SHIFT-KEY PRESS
+        if (pressed) {
+            queue_key(key_enum_to_linux_code.at(EKey::LEFT_SHIFT), press_value);
+
+            queue_key(key_enum_to_linux_code.at(active_key.key_enum_of_unshifted_version), press_value);
+
+        } else { // KEY-SHIFT RELEASE
+            queue_key(key_enum_to_linux_code.at(active_key.key_enum_of_unshifted_version), press_value);
+            queue_key(key_enum_to_linux_code.at(EKey::LEFT_SHIFT), press_value);
+        }
+
+        active_key_unshifted.pressed_signal.set(pressed);
+        shift_key.pressed_signal.set(pressed);
+    } else {
+        queue_key(key_enum_to_linux_code.at(key_enum), press_value);
+        active_key.pressed_signal.set(pressed);
+    }
+}
+
+void KeyInterceptor::forward_keys(const KeyBitmap &keys, int value) {
+    keys.for_each_set_key([&](int linux_code) {
+        EKey key_enum = linux_input_adapter.linux_code_to_key_enum.at(linux_code);
+        bool key_should_be_ignored = collection_utils::contains(keys_to_ignore_this_update, key_enum);
+        if (key_should_be_ignored)
+            return;
+
+        forwarding_linux_code = linux_code;
+        send_key_to_virtual_keyboard(key_enum, value);
+        forwarding_linux_code = -1;
+    });
+}
+
+void KeyInterceptor::forward_relative_motion() {
+    queue_relative_motion(linux_input_adapter.take_relative_motion());
+}
+
+void KeyInterceptor::queue_relative_motion(const LinuxInputAdapter::RelativeMotion &motion) {
+    if (motion.empty())
+        return;
+
+    struct input_event events[7];
+    size_t num_events = make_relative_motion_events(events, motion.x, motion.y, motion.wheel, motion.hwheel,
+                                                    motion.wheel_hi_res, motion.hwheel_hi_res);
+    output_sink->write_events(events, num_events);
+}
+
+std::chrono::steady_clock::time_point KeyInterceptor::get_current_time() const {
+    if (current_event_time.has_value())
+        return *current_event_time;
+    return std::chrono::steady_clock::now();
+}
+
+void KeyInterceptor::end_tick() {
+    keys_to_ignore_this_update.clear();
+    linux_input_adapter.key_bitmap_state.process();
+    input_state.process();
+    virtual_input_state.process();
+}
+
+void KeyInterceptor::begin_update() {
+    poll_events();
+    // global_logger->debug("space just pressed: {}", input_state.is_just_pressed(EKey::SPACE));
+
+    // NOTE: rendering the keyboard is far more expensive than the rest of the tick, key_interceptor_viewer shows it
+    if (logging_enabled)
+        global_logger->info(input_state.get_visual_keyboard_state());
+
+    forward_relative_motion();
+}
+
+void KeyInterceptor::finish_update() {
+    // key forwarding required as we grab exclusive control of the keyboard.
+    const KeyBitmapState &key_bitmap_state = linux_input_adapter.key_bitmap_state;
+    forward_keys(key_bitmap_state.get_just_pressed(), LinuxInputAdapter::press_value);
+    forward_keys(key_bitmap_state.get_held(), LinuxInputAdapter::repeat_value);
+    forward_keys(key_bitmap_state.get_just_released(), LinuxInputAdapter::release_value);
+    // NOTE: the motion read after the first frame that changed a key, begin_update sent everything before it
+    forward_relative_motion();
+
+    flush_output();
+
+    end_tick();
+}
+
+size_t KeyInterceptor::read_events(struct input_event *events, size_t max_events) {
+    size_t num_events = input_source->read_events(events, max_events);
+    note_key_events_read(events, num_events);
+    return num_events;
+}
+
+bool KeyInterceptor::apply_event_in_order(const struct input_event &ev, int &repeated_linux_code) {
+    const KeyBitmapState &key_bitmap_state = linux_input_adapter.key_bitmap_state;
+    linux_input_adapter.process_events(&ev, 1);
+
+    // motion is forwarded per frame so it stays in order with the button presses around it
+    if (ev.type == EV_SYN and ev.code == SYN_REPORT)
+        forward_relative_motion();
+
+    // the bitmap only holds keys we know about, so a repeat of anything else is dropped like it is in tick mode
+    bool is_repeat = ev.type == EV_KEY and ev.value == LinuxInputAdapter::repeat_value and
+                     key_bitmap_state.current.test(ev.code);
+    // NOTE: also catches the keys changed by a resync after SYN_DROPPED, which happens on a SYN_REPORT
+    bool key_state_changed = key_bitmap_state.current != key_bitmap_state.previous;
+    if (not is_repeat and not key_state_changed)
+        return false;
+
+    repeated_linux_code = is_repeat ? ev.code : -1;
+    if (linux_input_adapter.has_monotonic_event_times())
+        current_event_time = LinuxInputAdapter::get_event_time(ev);
+    return true;
+}
+
+void KeyInterceptor::forward_changes_and_end_tick(int repeated_linux_code) {
+    const KeyBitmapState &key_bitmap_state = linux_input_adapter.key_bitmap_state;
+    forward_keys(key_bitmap_state.get_just_pressed(), LinuxInputAdapter::press_value);
+    forward_keys(key_bitmap_state.get_just_released(), LinuxInputAdapter::release_value);
+
+    if (repeated_linux_code >= 0) {
+        KeyBitmap repeated_key;
+        repeated_key.set(repeated_linux_code, true);
+        forward_keys(repeated_key, LinuxInputAdapter::repeat_value);
+    }
+
+    end_tick();
+    current_event_time.reset();
+}
+
+void KeyInterceptor::queue_injected_events() {
+    if (injection_socket == nullptr)
+        return;
+
+    injected_events.clear();
+    if (injection_socket->receive(injected_events) == 0)
+        return;
+
+    queuing_injected_events = true;
+    for (const injection::KeyEvent &event : injected_events)
+        queue_key(event.linux_code, event.value);
+    queuing_injected_events = false;
+}
+
+void KeyInterceptor::flush_output() {
+    queue_injected_events();
+
+    TraceScope trace_scope("write");
+    output_sink->flush();
+
+    // NOTE: every event read since the last write is closed here, including the ones the logic swallowed
+    if (trace::is_enabled()) {
+        for (uint64_t id = first_unwritten_trace_event_id; id < next_trace_event_id; id++)
+            trace::record_key_event_written(id);
+    }
+    first_unwritten_trace_event_id = next_trace_event_id;
+}
+
+void KeyInterceptor::note_key_events_read(const struct input_event *events, size_t num_events) {
+    bool tracing = trace::is_enabled();
+    if (not tracing and latency_measurement == nullptr)
+        return;
+
+    for (size_t i = 0; i < num_events; i++) {
+        const struct input_event &ev = events[i];
+        if (ev.type != EV_KEY)
+            continue;
+
+        if (tracing)
+            trace::record_key_event_read(next_trace_event_id++);
+
+        if (latency_measurement != nullptr and ev.code < KEY_CNT) {
+            last_key_event_time = LinuxInputAdapter::get_event_time(ev);
+            key_event_times[ev.code] = last_key_event_time;
+        }
+    }
+}
+
+void KeyInterceptor::update() {
+    if (not check_in_with_stall_watchdog())
+        return;
+
+    if (event_sourced) {
+        update_event_sourced();
+        return;
+    }
+
+    GlobalLogSection _("update", logging_enabled);
+    TraceScope trace_scope("update");
+    begin_update();
+    logic();
+    finish_update();
+}
+
+void KeyInterceptor::update_event_sourced() {
+    GlobalLogSection _("update_event_sourced", logging_enabled);
+    TraceScope trace_scope("update_event_sourced");
+
+    bool logic_ran = false;
+    struct input_event events[64];
+    size_t num_events;
+    while ((num_events = read_events(events, 64)) > 0) {
+        for (size_t i = 0; i < num_events; i++) {
+            int repeated_linux_code;
+            if (not apply_event_in_order(events[i], repeated_linux_code))
+                continue;
+
+            logic();
+            forward_changes_and_end_tick(repeated_linux_code);
+            logic_ran = true;
+        }
+    }
+
+    // NOTE: the logic also has to run when no key changed so that its timers can expire, eg the delayed space of
+    // the space tap activation mode, and when a debounced key settled after its last event was read
+    bool keys_settled = linux_input_adapter.settle_debounced_keys();
+    if (not logic_ran or keys_settled) {
+        logic();
+        forward_changes_and_end_tick(-1);
+    }
+
+    flush_output();
+}
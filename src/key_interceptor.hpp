@@ -0,0 +1,181 @@
+#ifndef KEY_INTERCEPTOR_HPP
+#define KEY_INTERCEPTOR_HPP
+
+#include "input/input_state/input_state.hpp"
+#include "input/linux_input_adapter/linux_input_adapter.hpp"
+
+#include "injection_socket.hpp"
+#include "input_output_backend.hpp"
+#include "input_source.hpp"
+#include "latency_measurement.hpp"
+#include "output_sink.hpp"
+#include "stall_watchdog.hpp"
+#include "trace.hpp"
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief a class that process keys from the operating system and optionally forwards them to a virtul keyboard device,
+ * allows you to determine which keystrokes pass through (forwarding) or do not, and additionally allow you to run
+ * intermediate logic to generate other keystrokes
+ *
+ * NOTE: all of its state is its own, so several interceptors can run at once as long as each one is only ever updated
+ * from one thread at a time
+ */
+class KeyInterceptor {
+  public:
+    std::function<void()> logic;
+
+    // interactively asks which device to intercept and creates the virtual keyboard
+    explicit KeyInterceptor(std::function<void()> logic);
+    // reads the given evdev device and writes to the given uinput virtual keyboard
+    KeyInterceptor(std::function<void()> logic, const std::string &device_name, int virtual_keyboard_file_descriptor,
+                   bool exclusive_control);
+    // reads and writes somewhere else entirely, eg in memory, there's no device to grab or resync from
+    KeyInterceptor(std::function<void()> logic, std::unique_ptr<InputSource> input_source,
+                   std::unique_ptr<OutputSink> output_sink);
+
+    std::string device_name;
+    // -1 when not writing to a uinput device
+    int virtual_keyboard_file_descriptor = -1;
+
+    // the keys of the keyboard being read, and the keys as they were sent to the virtual keyboard
+    InputState input_state;
+    InputState virtual_input_state;
+
+    LinuxInputAdapter linux_input_adapter;
+
+    std::unordered_map<EKey, int> key_enum_to_linux_code;
+
+    // how the device is read and the virtual keyboard written, only used when there is a device
+    std::unique_ptr<InputOutputBackend> input_output_backend;
+    void set_input_output_backend(std::unique_ptr<InputOutputBackend> backend);
+
+    std::unique_ptr<InputSource> input_source;
+    // every event a tick produces is queued here and written out together at the end of update
+    std::unique_ptr<OutputSink> output_sink;
+
+    // blocks until the input source (or a wake up source) has something to read or timeout_ms passes
+    bool wait_for_input(int timeout_ms);
+
+    // a file descriptor that wait_for_input also wakes up for, kept across a change of backend
+    void add_wake_up_source(int file_descriptor);
+
+    // queues relative motion for the virtual keyboard, eg motion the logic generates itself
+    void queue_relative_motion(const LinuxInputAdapter::RelativeMotion &motion);
+
+    std::vector<EKey> keys_to_ignore_this_update;
+
+    // every key that is currently down on the virtual keyboard, by linux code, as of the last event queued for it
+    KeyBitmap virtual_keys;
+
+    bool logging_enabled = false;
+
+    // optional, when set every key sent to the virtual keyboard is reported to it along with the source event it came
+    // from
+    LatencyMeasurement *latency_measurement = nullptr;
+    void set_latency_measurement(LatencyMeasurement *latency_measurement);
+
+    // optional, when set the keys other programs send to it are typed with whatever each update sends, after it
+    InjectionSocket *injection_socket = nullptr;
+    void set_injection_socket(InjectionSocket *injection_socket);
+
+    // optional, when set every update checks in with it and every key sent to the virtual keyboard is reported to it
+    StallWatchdog *stall_watchdog = nullptr;
+    void set_stall_watchdog(StallWatchdog *stall_watchdog);
+
+    // will make the key occur on the virtual keyboard and also go through the virtual input state for analysis
+    void send_key_to_virtual_keyboard(EKey key_enum, int press_value);
+
+    void poll_events();
+
+    // queues a key event and its SYN_REPORT for the virtual keyboard, without touching the virtual input state
+    void queue_key(int linux_code, int value);
+
+    // sends every key in the bitmap (by linux code) that isn't being ignored this update with the given value
+    void forward_keys(const KeyBitmap &keys, int value);
+
+    // mouse motion is never remapped so it is passed straight through, coalesced into one event per axis
+    void forward_relative_motion();
+
+    /**
+     * @brief when false (the default) update reads everything that is ready and runs the logic once on the resulting
+     * state, so the order of events within a tick is lost and a key pressed and released within a tick is never seen.
+     *
+     * When true update runs the logic once per key event in the order they were read, forwarding that event right
+     * after, so what comes out is in the same order as what went in no matter how fast you type. Repeats then come
+     * from the kernel's repeat events instead of from every tick. Pair it with wait_for_input so
+     * each event is handled as soon as it arrives.
+     */
+    bool event_sourced = false;
+
+    // the time the logic should treat as now, in event sourced mode this is the kernel timestamp of the event being
+    // processed (when the device supports monotonic timestamps), otherwise the current time
+    std::chrono::steady_clock::time_point get_current_time() const;
+
+    // advances the key states to the next tick, call after everything that reads this tick's changes has run
+    void end_tick();
+
+    void update();
+
+  private:
+    void update_event_sourced();
+
+    /**
+     * @brief tells the stall watchdog the loop is alive. After the watchdog gave the keyboard back, everything read in
+     * the meantime already reached the os, so it's thrown away until no key is down and the keyboard can be grabbed
+     * again without leaving a key stuck in the os. Returns false while that's going on, the update is then skipped.
+     */
+    bool check_in_with_stall_watchdog();
+
+    // the parts of a tick before and after the logic runs
+    void begin_update();
+    void finish_update();
+
+    size_t read_events(struct input_event *events, size_t max_events);
+
+    // one step of event sourced mode, returns true if the logic has to run for the event, in which case
+    // repeated_linux_code is set to the key being repeated by the kernel or -1
+    bool apply_event_in_order(const struct input_event &ev, int &repeated_linux_code);
+
+    // forwards the keys that changed since the logic last ran, plus the given kernel repeat if not -1
+    void forward_changes_and_end_tick(int repeated_linux_code);
+
+    // queues what was sent to the injection socket and writes out everything queued for the virtual keyboard
+    void flush_output();
+
+    void initialize_key_enum_to_linux_code();
+
+    // re-added to the backend whenever it's replaced
+    std::vector<int> wake_up_file_descriptors;
+
+    std::optional<std::chrono::steady_clock::time_point> current_event_time;
+
+    // while tracing, every key event read gets an id which is closed by the next write, see trace.hpp
+    uint64_t next_trace_event_id = 1;
+    uint64_t first_unwritten_trace_event_id = 1;
+
+    // kernel timestamps of the last event of every key and of the last key event overall, for the latency measurement
+    std::array<std::chrono::steady_clock::time_point, KEY_CNT> key_event_times{};
+    std::chrono::steady_clock::time_point last_key_event_time;
+    // the key forward_keys is passing through, or -1 while the logic is sending keys
+    int forwarding_linux_code = -1;
+
+    // reused across updates so receiving doesn't allocate
+    std::vector<injection::KeyEvent> injected_events;
+    // injected keys have no source event so they're left out of the latency measurement
+    bool queuing_injected_events = false;
+    void queue_injected_events();
+
+    // hands out trace ids and records the times for the latency measurement
+    void note_key_events_read(const struct input_event *events, size_t num_events);
+};
+
+#endif // KEY_INTERCEPTOR_HPP
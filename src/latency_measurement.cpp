@@ -0,0 +1,132 @@
+#include "latency_measurement.hpp"
+
+#include "input/linux_input_adapter/linux_input_adapter.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <linux/input.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+// anything expected this long before the event being matched is assumed to have never come out
+static constexpr auto lost_event_age = std::chrono::seconds(1);
+
+LatencyMeasurement::LatencyMeasurement(const std::string &virtual_keyboard_event_path) {
+    // NOTE: udev may still be creating the event node of a virtual keyboard that was just made
+    for (int attempt = 0; attempt < 20 and file_descriptor < 0; attempt++) {
+        file_descriptor = open(virtual_keyboard_event_path.c_str(), O_RDONLY | O_NONBLOCK);
+        if (file_descriptor < 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    if (file_descriptor < 0) {
+        perror("open virtual keyboard for latency measurement");
+        return;
+    }
+
+    int clock_id = CLOCK_MONOTONIC;
+    if (ioctl(file_descriptor, EVIOCSCLOCKID, &clock_id) < 0)
+        perror("EVIOCSCLOCKID virtual keyboard");
+
+    reader_thread = std::thread([this]() { read_virtual_keyboard(); });
+}
+
+LatencyMeasurement::~LatencyMeasurement() {
+    stop_requested = true;
+    if (reader_thread.joinable())
+        reader_thread.join();
+    if (file_descriptor >= 0)
+        close(file_descriptor);
+}
+
+void LatencyMeasurement::expect(int linux_code, int value, Clock::time_point source_time, Path path) {
+    if (not is_running() or value == LinuxInputAdapter::repeat_value or linux_code < 0 or linux_code >= KEY_CNT)
+        return;
+
+    std::lock_guard lock(mutex);
+    expected_events[linux_code][value].push_back({source_time, path});
+}
+
+void LatencyMeasurement::read_virtual_keyboard() {
+    while (not stop_requested) {
+        struct pollfd poll_file_descriptor = {file_descriptor, POLLIN, 0};
+        // the timeout is only there to notice stop_requested
+        if (poll(&poll_file_descriptor, 1, 100) <= 0)
+            continue;
+
+        struct input_event events[64];
+        ssize_t num_bytes;
+        while ((num_bytes = read(file_descriptor, events, sizeof(events))) > 0) {
+            for (size_t i = 0; i < num_bytes / sizeof(struct input_event); i++) {
+                const struct input_event &ev = events[i];
+                if (ev.type == EV_KEY and ev.value != LinuxInputAdapter::repeat_value)
+                    match(ev.code, ev.value, LinuxInputAdapter::get_event_time(ev));
+            }
+        }
+    }
+}
+
+void LatencyMeasurement::match(int linux_code, int value, Clock::time_point output_time) {
+    if (linux_code >= KEY_CNT)
+        return;
+
+    std::lock_guard lock(mutex);
+    auto &expected = expected_events[linux_code][value];
+
+    // eg the kernel drops a press of a key that is already down, so what was expected for it never comes out
+    while (not expected.empty() and expected.front().source_time + lost_event_age < output_time) {
+        expected.pop_front();
+        num_lost_events++;
+    }
+
+    if (expected.empty()) {
+        num_unexpected_events++;
+        return;
+    }
+
+    ExpectedEvent expected_event = expected.front();
+    expected.pop_front();
+    latencies[static_cast<size_t>(expected_event.path)].push_back(output_time - expected_event.source_time);
+}
+
+static double get_percentile_us(const std::vector<LatencyMeasurement::Clock::duration> &sorted_latencies,
+                                double fraction) {
+    if (sorted_latencies.empty())
+        return 0;
+    size_t index = std::min(sorted_latencies.size() - 1, static_cast<size_t>(fraction * sorted_latencies.size()));
+    return std::chrono::duration<double, std::micro>(sorted_latencies[index]).count();
+}
+
+void LatencyMeasurement::report(std::ostream &out) {
+    std::lock_guard lock(mutex);
+
+    size_t num_still_expected = 0;
+    for (const auto &per_value : expected_events)
+        for (const auto &expected : per_value)
+            num_still_expected += expected.size();
+
+    out << std::fixed << std::setprecision(1);
+    out << "added latency, source keyboard to virtual keyboard (kernel timestamps)\n";
+    for (size_t i = 0; i < num_paths; i++) {
+        std::vector<Clock::duration> sorted_latencies = latencies[i];
+        std::sort(sorted_latencies.begin(), sorted_latencies.end());
+        out << "  " << std::setw(11) << std::left << to_string(static_cast<Path>(i)) << std::right
+            << sorted_latencies.size() << " events, p50 " << get_percentile_us(sorted_latencies, 0.5) << "us, p99 "
+            << get_percentile_us(sorted_latencies, 0.99) << "us, max " << get_percentile_us(sorted_latencies, 1.0)
+            << "us\n";
+    }
+    out << "  lost " << num_lost_events + num_still_expected << ", unexpected " << num_unexpected_events << "\n";
+}
+
+std::string to_string(LatencyMeasurement::Path path) {
+    switch (path) {
+    case LatencyMeasurement::Path::forwarded:
+        return "forwarded";
+    case LatencyMeasurement::Path::generated:
+        return "generated";
+    }
+    return "unknown";
+}
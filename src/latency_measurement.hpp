@@ -0,0 +1,75 @@
+#ifndef LATENCY_MEASUREMENT_HPP
+#define LATENCY_MEASUREMENT_HPP
+
+#include <linux/input-event-codes.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief measures the latency the interceptor really adds, from the kernel timestamp of an event on the source keyboard
+ * to the kernel timestamp of what it turned into on the virtual keyboard, which includes the uinput to evdev hop and
+ * the scheduling of the input thread that timestamps taken inside the interceptor miss.
+ *
+ * The interceptor calls expect for every key event it queues for the virtual keyboard, together with the time of the
+ * source event it came from. A second thread reads the virtual keyboard's own event node (without grabbing it, so the
+ * desktop still gets everything) and matches each event that comes out to what was expected by key code, value and
+ * order, so the n-th press of a key is matched with the n-th expected press of that key.
+ *
+ * NOTE: both ends have to be stamped with CLOCK_MONOTONIC, so it only makes sense when the source keyboard supports
+ * EVIOCSCLOCKID, see LinuxInputAdapter::has_monotonic_event_times
+ */
+class LatencyMeasurement {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Path {
+        // passed through unchanged by forward_keys
+        forwarded,
+        // sent by the logic, eg remapped keys or the delayed space of a space tap
+        generated,
+    };
+    static constexpr size_t num_paths = 2;
+
+    explicit LatencyMeasurement(const std::string &virtual_keyboard_event_path);
+    ~LatencyMeasurement();
+
+    bool is_running() const { return file_descriptor >= 0; }
+
+    // called from the input thread, repeats are ignored since the kernel doesn't pass on repeats of a released key
+    void expect(int linux_code, int value, Clock::time_point source_time, Path path);
+
+    // p50, p99 and max per path, plus how many events never came out and how many came out without being expected
+    void report(std::ostream &out);
+
+  private:
+    struct ExpectedEvent {
+        Clock::time_point source_time;
+        Path path;
+    };
+
+    int file_descriptor = -1;
+    std::atomic<bool> stop_requested = false;
+    std::thread reader_thread;
+
+    std::mutex mutex;
+    // per key code and value (release or press)
+    std::deque<ExpectedEvent> expected_events[KEY_CNT][2];
+    std::vector<Clock::duration> latencies[num_paths];
+    size_t num_lost_events = 0;
+    size_t num_unexpected_events = 0;
+
+    void read_virtual_keyboard();
+    void match(int linux_code, int value, Clock::time_point output_time);
+};
+
+std::string to_string(LatencyMeasurement::Path path);
+
+#endif // LATENCY_MEASUREMENT_HPP
@@ -1,592 +1,26 @@
-#include "input/input_state/input_state.hpp"
-#include "input/linux_input_adapter/linux_input_adapter.hpp"
-
+#include "chord_system.hpp"
+#include "combo_threshold_learner.hpp"
+#include "injection_socket.hpp"
+#include "key_interceptor.hpp"
+#include "latency_measurement.hpp"
 #include "select_linux_device.hpp"
+#include "stall_watchdog.hpp"
+#include "state_snapshot.hpp"
+#include "trace.hpp"
+#include "usage_statistics.hpp"
 
-#include "utility/temporal_binary_switch/temporal_binary_switch.hpp"
 #include "utility/fixed_frequency_loop/fixed_frequency_loop.hpp"
-#include "utility/collection_utils/collection_utils.hpp"
-#include "utility/text_utils/text_utils.hpp"
 #include "utility/logger/logger.hpp"
-#include "utility/timer/timer.hpp"
 
-#include <chrono>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
 #include <iostream>
-#include <ratio>
-
-InputState input_state;
-InputState virtual_input_state;
-
-/**
- * @brief a class that process keys from the operating system and optionally forwards them to a virtul keyboard device,
- * allows you to determine which keystrokes pass through (forwarding) or do not, and additionally allow you to run
- * intermediate logic to generate other keystrokes
- */
-class KeyInterceptor {
-  public:
-    std::function<void()> logic;
-
-    KeyInterceptor(std::function<void()> logic)
-        : device_name(interactively_select_linux_device_name()),
-          virtual_keyboard_file_descriptor(create_virtual_keyboard_device()),
-          linux_input_adapter(input_state, device_name, true), logic(logic) {
-        key_enum_to_linux_code = collection_utils::invert(linux_input_adapter.linux_code_to_key_enum);
-
-        // NOTE: the reason why this is here is because for some reason just sending over KEY_ENTER to the virtual
-        // keyboard doesn't work properly, and this fixes it and I don't exactly know why.
-        key_enum_to_linux_code.at(EKey::ENTER) = KEY_KPENTER;
-    }
-
-    std::string device_name;
-    int virtual_keyboard_file_descriptor;
-    LinuxInputAdapter linux_input_adapter;
-
-    std::unordered_map<EKey, int> key_enum_to_linux_code;
-
-    std::vector<EKey> keys_to_ignore_this_update;
-
-    bool logging_enabled = false;
-
-    // will make the key occur on the virtual keyboard and also go through the virtual input state for analysis
-    void send_key_to_virtual_keyboard(EKey key_enum, int press_value) {
-
-        bool pressed = press_value > 0;
-
-        Key &active_key = *(virtual_input_state.key_enum_to_object.at(key_enum));
-        if (active_key.requires_modifer_to_be_typed) {
-
-            Key &active_key_unshifted =
-                *(virtual_input_state.key_enum_to_object.at(active_key.key_enum_of_unshifted_version));
-            Key &shift_key = *(virtual_input_state.key_enum_to_object.at(EKey::LEFT_SHIFT));
-            // SHIFT-KEY PRESS
-            if (pressed) {
-                send_key(virtual_keyboard_file_descriptor, key_enum_to_linux_code.at(EKey::LEFT_SHIFT), press_value);
-
-                send_key(virtual_keyboard_file_descriptor,
-                         key_enum_to_linux_code.at(active_key.key_enum_of_unshifted_version), press_value);
-
-            } else { // KEY-SHIFT RELEASE
-                send_key(virtual_keyboard_file_descriptor,
-                         key_enum_to_linux_code.at(active_key.key_enum_of_unshifted_version), press_value);
-                send_key(virtual_keyboard_file_descriptor, key_enum_to_linux_code.at(EKey::LEFT_SHIFT), press_value);
-            }
-
-            active_key_unshifted.pressed_signal.set(pressed);
-            shift_key.pressed_signal.set(pressed);
-        } else {
-            send_key(virtual_keyboard_file_descriptor, key_enum_to_linux_code.at(key_enum), press_value);
-            active_key.pressed_signal.set(pressed);
-        }
-    }
-
-    void update() {
-        GlobalLogSection _("update", logging_enabled);
-
-        linux_input_adapter.poll_events();
-        // global_logger->debug("space just pressed: {}", input_state.is_just_pressed(EKey::SPACE));
-
-        global_logger->info(input_state.get_visual_keyboard_state());
-
-        logic();
-
-        // key forwarding required as we grab exclusive control of the keyboard.
-        for (const auto &key_enum : input_state.get_just_pressed_keys()) {
-            bool key_should_be_ignored = collection_utils::contains(keys_to_ignore_this_update, key_enum);
-            if (key_should_be_ignored)
-                continue;
-
-            send_key_to_virtual_keyboard(key_enum, LinuxInputAdapter::press_value);
-        }
-
-        for (const auto &key_enum : input_state.get_held_keys()) {
-            bool key_should_be_ignored = collection_utils::contains(keys_to_ignore_this_update, key_enum);
-            if (key_should_be_ignored)
-                continue;
-
-            send_key_to_virtual_keyboard(key_enum, LinuxInputAdapter::repeat_value);
-        }
-
-        for (const auto &key_enum : input_state.get_just_released_keys()) {
-            bool key_should_be_ignored = collection_utils::contains(keys_to_ignore_this_update, key_enum);
-            if (key_should_be_ignored)
-                continue;
-
-            send_key_to_virtual_keyboard(key_enum, LinuxInputAdapter::release_value);
-        }
-
-        keys_to_ignore_this_update.clear();
-        input_state.process();
-        virtual_input_state.process();
-    }
-};
-
-struct SimultaneousKeypresses {
-    using Clock = std::chrono::steady_clock;
-    using TimePoint = Clock::time_point;
-
-    KeyInterceptor &key_interceptor;
-
-    SimultaneousKeypresses(std::chrono::milliseconds t, KeyInterceptor &key_interceptor)
-        : threshold(t), key_interceptor(key_interceptor) {}
-
-    struct Combo {
-        EKey key1;
-        EKey key2;
-        std::function<void()> callback;
-    };
-
-    std::chrono::milliseconds threshold;
-    std::unordered_map<EKey, TimePoint> key_pressed_times;
-    std::vector<Combo> combos;
-
-    std::chrono::milliseconds last_duration;
-
-    void register_combo(EKey key1, EKey key2, std::function<void()> callback) {
-        combos.push_back({key1, key2, callback});
-    }
-
-    // call this every update
-    void process() {
-        // record timestamps for keys that were just pressed
-        for (auto &combo : combos) {
-            for (EKey key : {combo.key1, combo.key2}) {
-                if (input_state.get_current_state(key) == TemporalBinarySwitch::State::just_switched_on) {
-                    key_pressed_times[key] = Clock::now();
-                }
-            }
-        }
-
-        // check all combos
-        for (auto &combo : combos) {
-            if (input_state.is_pressed(combo.key1) && input_state.is_pressed(combo.key2)) {
-                auto it1 = key_pressed_times.find(combo.key1);
-                auto it2 = key_pressed_times.find(combo.key2);
-
-                if (it1 != key_pressed_times.end() && it2 != key_pressed_times.end()) {
-                    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(it2->second - it1->second);
-                    auto abs_duration = std::chrono::milliseconds(std::abs(duration.count()));
-                    last_duration = abs_duration;
-
-                    if (abs_duration.count() >= 0 && abs_duration < threshold) {
-                        combo.callback();
-
-                        // Optionally ignore keys for this update
-                        key_interceptor.keys_to_ignore_this_update.push_back(combo.key1);
-                        key_interceptor.keys_to_ignore_this_update.push_back(combo.key2);
-                    }
-                }
-            }
-        }
-    }
-};
-
-/**
- *
- * Motivation:
- *
- * vim taught us that we can avoid reaching for our mouse. Once mastered, we should continue this pattern in memory of
- * vim. Moreover if you are a programmer or someone who usese the computer for a lot of time then you should be
- * investing in the ability to continue doing this. If one day you got a repetitive strain injury and were no longer
- * able to type anymore it would be a sad day.
- *
- * Ok so applying the same reasoning that moving your hand is bad, then we just have to see how we currently move our
- * hand. Most vimmers already rebind escape to caps lock because they understand this concept, but thats usually where
- * it ends. Let's not stop there, instead we should realize that anytime we have to move away from the homerow this is
- * usually a hand movement, the worst offenders are those where we have to slightly adjust the hand to reach our pinky
- * out to grab a key, such as caps lock, delete, tab, enter etc.
- *
- * Our solution to this problem is to move this keys inward so that no hand adjustments have to made. This is a sort of
- * mapping layer, but how do we activate this mapping layer?
- *
- * Clearly we want to adhere to the principle of not moving your hand and so we don't have the option of enabling this
- * mapping mode with traditional keys like ctrl/alt/super etc so instead we have to try something new.
- *
- * Space is the biggest key on the keyboard and pressed by the strongest finger on your hand, so leveraging this key
- * would be good, simply mapping space to activate the mapping mode would be bad, because we use space for other thing
- * as well.
- *
- * One area that we can take advantage of is timing. If we get the user to press space in fast succession we'll enable
- * the mapping layer, if the second space is not emitted within the time frame then we can the mode is not activated,
- * and if you press any key other than space after hitting space, then the mod will also not be activated. This keeps
- * the regular behavior while adding the mapping layer if you know the timing and go fast.
- *
- * TLDR:
- *
- * space tap, space hold in fast succession activates the mapping mode, in this mode, certain keys are remapped to other
- * keys
- *
- * when space is released the mapping mode turns off and keys go back to their regular function unless the following is
- * true
- *
- * if a key is remapped by the mode and it is continually held down even when space is released then it continues to
- * repeat the mapped key.
- *
- * the purpose of this extra functionality is to allow you to combine mapped and unmapped keys, so for example if / is
- * mapped to right shift in the mapped state and a is mapped to escape in the mapped state, then it's impossible to type
- * shift-a in the mapped state because a is already being mapped to something. In order to allow for such situation we
- * need to be able to conditionally keep mapped keys active, and to do this we use above method. In this way we can
- * activate the mapping mode, and then hold down / to keep shift active
- *
- * TODO: another feature that I want to add is the ability to do punch through toggling, what this means is that you hit
- * space space to enter the mode, and while this is active there should be a way to temporarliy just toggle the mode so
- * maybe akey where you press it down nd it will temporarily disable the mapping mode.
- *
- * the point is that you can type things like this_thing_here, without having to spam space so much
- *
- */
-// TODO: this needs to be renamed, and then the one with these specific mappings is the homebody keyboard mappings
-class ChordSystem {
-
-  public:
-    struct SingleKeyMap {
-        EKey input_key;
-        EKey output_key;
-        bool active = false;
-        TemporalBinarySwitch active_tbs;
-    };
-
-    enum class MapName {
-        homesick,
-        number_pulldown,
-        programming,
-        shift_lock,
-        vim_arrows,
-    };
-
-    struct KeyMap {
-        MapName map_name;
-        std::vector<SingleKeyMap> key_mappings;
-
-        void add_key_mapping(EKey input_key, EKey output_key) { key_mappings.emplace_back(input_key, output_key); }
-    };
-
-    KeyMap key_map;
-
-    std::unordered_map<MapName, KeyMap> map_name_to_key_map = {
-        {MapName::homesick, KeyMap()},   {MapName::number_pulldown, KeyMap()}, {MapName::programming, KeyMap()},
-        {MapName::shift_lock, KeyMap()}, {MapName::vim_arrows, KeyMap()},
-    };
-
-    MapName current_mapping = MapName::homesick;
-
-    void add_chord_mapping(EKey input_key, EKey output_key) {
-        key_map.key_mappings.emplace_back(input_key, output_key);
-    }
-
-    SimultaneousKeypresses simultaneous_keypresses{std::chrono::milliseconds(35), key_interceptor};
-    ChordSystem() : key_interceptor([this]() { per_iteration_logic(); }) {
-        // homesick
-
-        auto &homesick_mapping = map_name_to_key_map.at(MapName::homesick);
-
-        homesick_mapping.add_key_mapping(EKey::q, EKey::TAB);
-        homesick_mapping.add_key_mapping(EKey::w, EKey::GRAVE_ACCENT);
-
-        homesick_mapping.add_key_mapping(EKey::a, EKey::ESCAPE);
-
-        homesick_mapping.add_key_mapping(EKey::z, EKey::LEFT_SHIFT);
-        homesick_mapping.add_key_mapping(EKey::x, EKey::LEFT_CONTROL);
-        homesick_mapping.add_key_mapping(EKey::c, EKey::LEFT_SUPER);
-        homesick_mapping.add_key_mapping(EKey::v, EKey::LEFT_ALT);
-
-        homesick_mapping.add_key_mapping(EKey::u, EKey::BACKSPACE);
-        homesick_mapping.add_key_mapping(EKey::i, EKey::LEFT_SQUARE_BRACKET);
-        homesick_mapping.add_key_mapping(EKey::o, EKey::RIGHT_SQUARE_BRACKET);
-        homesick_mapping.add_key_mapping(EKey::p, EKey::BACKSLASH);
-
-        homesick_mapping.add_key_mapping(EKey::l, EKey::SINGLE_QUOTE);
-        homesick_mapping.add_key_mapping(EKey::SEMICOLON, EKey::ENTER);
-
-        // add_chord_mapping(EKey::n, EKey::FUNCTION_KEY);
-        // homesick_mapping.add_key_mapping(EKey::m, EKey::MENU_KEY);
-        homesick_mapping.add_key_mapping(EKey::COMMA, EKey::RIGHT_ALT);
-        homesick_mapping.add_key_mapping(EKey::PERIOD, EKey::RIGHT_CONTROL);
-        homesick_mapping.add_key_mapping(EKey::SLASH, EKey::RIGHT_SHIFT);
-
-        auto &number_pulldown_mapping = map_name_to_key_map.at(MapName::number_pulldown);
-        number_pulldown_mapping.add_key_mapping(EKey::a, EKey::ONE);
-        number_pulldown_mapping.add_key_mapping(EKey::s, EKey::TWO);
-        number_pulldown_mapping.add_key_mapping(EKey::d, EKey::THREE);
-        number_pulldown_mapping.add_key_mapping(EKey::f, EKey::FOUR);
-        number_pulldown_mapping.add_key_mapping(EKey::g, EKey::FIVE);
-        number_pulldown_mapping.add_key_mapping(EKey::h, EKey::SIX);
-        number_pulldown_mapping.add_key_mapping(EKey::j, EKey::SEVEN);
-        number_pulldown_mapping.add_key_mapping(EKey::k, EKey::EIGHT);
-        number_pulldown_mapping.add_key_mapping(EKey::l, EKey::NINE);
-        number_pulldown_mapping.add_key_mapping(EKey::SEMICOLON, EKey::ZERO);
-
-        // TODO: there's a problem right now when you try and send something like exclamation point because that's not a
-        // valid key in the context of the virtual keyboard instead we need to do a shift 1 or something of that form,
-        // this also has to be done when the mode is over and we're clearing stuff out.
-
-        number_pulldown_mapping.add_key_mapping(EKey::q, EKey::EXCLAMATION_POINT);
-        number_pulldown_mapping.add_key_mapping(EKey::w, EKey::AT_SIGN);
-        number_pulldown_mapping.add_key_mapping(EKey::e, EKey::NUMBER_SIGN);
-        number_pulldown_mapping.add_key_mapping(EKey::r, EKey::DOLLAR_SIGN);
-        number_pulldown_mapping.add_key_mapping(EKey::t, EKey::PERCENT_SIGN);
-        number_pulldown_mapping.add_key_mapping(EKey::y, EKey::CARET);
-        number_pulldown_mapping.add_key_mapping(EKey::u, EKey::AMPERSAND);
-        number_pulldown_mapping.add_key_mapping(EKey::i, EKey::ASTERISK);
-        number_pulldown_mapping.add_key_mapping(EKey::o, EKey::LEFT_PARENTHESIS);
-        number_pulldown_mapping.add_key_mapping(EKey::p, EKey::RIGHT_PARENTHESIS);
-
-        auto &programming_mapping = map_name_to_key_map.at(MapName::programming);
-
-        programming_mapping.add_key_mapping(EKey::f, EKey::LEFT_PARENTHESIS);  // (
-        programming_mapping.add_key_mapping(EKey::j, EKey::RIGHT_PARENTHESIS); // )
-
-        programming_mapping.add_key_mapping(EKey::d, EKey::LEFT_SQUARE_BRACKET);  // [
-        programming_mapping.add_key_mapping(EKey::k, EKey::RIGHT_SQUARE_BRACKET); // ]
-
-        programming_mapping.add_key_mapping(EKey::s, EKey::LESS_THAN);    // <
-        programming_mapping.add_key_mapping(EKey::l, EKey::GREATER_THAN); // >
-
-        programming_mapping.add_key_mapping(EKey::a, EKey::LEFT_CURLY_BRACKET);          // {
-        programming_mapping.add_key_mapping(EKey::SEMICOLON, EKey::RIGHT_CURLY_BRACKET); // }
-
-        programming_mapping.add_key_mapping(EKey::q, EKey::AMPERSAND);
-        programming_mapping.add_key_mapping(EKey::w, EKey::UNDERSCORE);
-        programming_mapping.add_key_mapping(EKey::e, EKey::EQUAL);
-
-        programming_mapping.add_key_mapping(EKey::u, EKey::PLUS);
-        programming_mapping.add_key_mapping(EKey::i, EKey::MINUS);
-        programming_mapping.add_key_mapping(EKey::o, EKey::ASTERISK);
-        programming_mapping.add_key_mapping(EKey::p, EKey::SLASH);
-
-        programming_mapping.add_key_mapping(EKey::x, EKey::COLON);
-
-        auto &vim_arrows = map_name_to_key_map.at(MapName::vim_arrows);
-        vim_arrows.add_key_mapping(EKey::h, EKey::LEFT);
-        vim_arrows.add_key_mapping(EKey::l, EKey::RIGHT);
-        vim_arrows.add_key_mapping(EKey::j, EKey::DOWN);
-        vim_arrows.add_key_mapping(EKey::k, EKey::UP);
-
-        auto &shift_lock = map_name_to_key_map.at(MapName::shift_lock);
-
-        for (auto &key : input_state.all_keys) {
-            if (key.shiftable) {
-                shift_lock.add_key_mapping(key.key_enum, key.key_enum_of_shifted_version);
-            }
-        }
-
-        if (not space_tap_mapping_activation_mode) {
-
-            simultaneous_keypresses.register_combo(EKey::SPACE, EKey::f, [&]() {
-                mapping_mode_active = true;
-                current_mapping = MapName::homesick;
-                key_used_to_start_mapping = EKey::f;
-            });
-            simultaneous_keypresses.register_combo(EKey::SPACE, EKey::j, [&]() {
-                mapping_mode_active = true;
-                current_mapping = MapName::homesick;
-                key_used_to_start_mapping = EKey::j;
-            });
-
-            simultaneous_keypresses.register_combo(EKey::SPACE, EKey::d, [&]() {
-                mapping_mode_active = true;
-                current_mapping = MapName::number_pulldown;
-                key_used_to_start_mapping = EKey::d;
-            });
-            simultaneous_keypresses.register_combo(EKey::SPACE, EKey::k, [&]() {
-                mapping_mode_active = true;
-                current_mapping = MapName::number_pulldown;
-                key_used_to_start_mapping = EKey::k;
-            });
-
-            simultaneous_keypresses.register_combo(EKey::SPACE, EKey::s, [&]() {
-                mapping_mode_active = true;
-                current_mapping = MapName::programming;
-                key_used_to_start_mapping = EKey::s;
-            });
-            simultaneous_keypresses.register_combo(EKey::SPACE, EKey::l, [&]() {
-                mapping_mode_active = true;
-                current_mapping = MapName::programming;
-                key_used_to_start_mapping = EKey::l;
-            });
-
-            simultaneous_keypresses.register_combo(EKey::SPACE, EKey::v, [&]() {
-                mapping_mode_active = true;
-                current_mapping = MapName::vim_arrows;
-                key_used_to_start_mapping = EKey::v;
-            });
-
-            simultaneous_keypresses.register_combo(EKey::SPACE, EKey::z, [&]() {
-                mapping_mode_active = true;
-                current_mapping = MapName::shift_lock;
-                key_used_to_start_mapping = EKey::z;
-            });
-            simultaneous_keypresses.register_combo(EKey::SPACE, EKey::SLASH, [&]() {
-                mapping_mode_active = true;
-                current_mapping = MapName::shift_lock;
-                key_used_to_start_mapping = EKey::SLASH;
-            });
-        }
-    }
-
-    KeyInterceptor key_interceptor;
-
-    bool timer_started_at_least_once = false;
-    Timer mapping_mode_activation_timer{0.2};
-
-    bool mapping_mode_active = false;
-    EKey key_used_to_start_mapping;
-
-    bool possibly_going_into_mapping_mode = false;
-
-    bool logging_enabled = false;
-
-    bool space_tap_mapping_activation_mode = false;
-
-    std::chrono::steady_clock::time_point space_pressed_time;
-    std::chrono::steady_clock::time_point f_pressed_time;
-
-    void per_iteration_logic() {
-
-        GlobalLogSection _("tick", logging_enabled);
-
-        if (space_tap_mapping_activation_mode) {
-            global_logger->debug("space signal state: {}",
-                                 input_state.key_enum_to_object.at(EKey::SPACE)->pressed_signal.to_string());
-
-            if (input_state.is_just_pressed(EKey::SPACE)) {
-                if (mapping_mode_activation_timer.time_up() or not timer_started_at_least_once) {
-                    mapping_mode_active = false;
-                    mapping_mode_activation_timer.start();
-                    possibly_going_into_mapping_mode = true;
-                    timer_started_at_least_once = true;
-                } else { // the timer was not up
-                    mapping_mode_active = true;
-                    global_logger->debug("chord started");
-                }
-                // If you manually press space, it gets ignored
-                key_interceptor.keys_to_ignore_this_update.push_back(EKey::SPACE);
-            }
-
-            // only if the time for the chord to start elapsed and you had pressed space we do a slightly delayed space
-            // emission
-            if (not mapping_mode_active and mapping_mode_activation_timer.time_up() and
-                possibly_going_into_mapping_mode) {
-                key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::press_value);
-                key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::release_value);
-                // you took too long so we're longer trying to
-                possibly_going_into_mapping_mode = false;
-            }
-
-            // TODO: this doesn't work because it needs to not be reset per iteration because it doesn't have any effect
-            // because it cannot effect more than one iteration and chord keys come through on different iterations
-            int num_consecutive_keys_to_modify = 1;
-
-            // chord ends here
-            if (input_state.is_just_released(EKey::SPACE) and mapping_mode_active) {
-                mapping_mode_active = false;
-                // turn off all possible output keys from the chord mapping so they don't repeat if they were held down
-                // when space was released.
-                for (auto &km : map_name_to_key_map.at(MapName::homesick).key_mappings) {
-
-                    // leave actively pressed keys on.
-                    if (input_state.is_pressed(km.input_key))
-                        continue;
-
-                    // release all other keys
-                    km.active = false;
-
-                    global_logger->info("about to turn off key: {}",
-                                        input_state.key_enum_to_object.at(km.input_key)->string_repr);
-
-                    key_interceptor.send_key_to_virtual_keyboard(km.output_key, LinuxInputAdapter::release_value);
-                }
-            }
-
-            auto just_pressed_keys = input_state.get_just_pressed_keys();
-            bool used_non_space_key =
-                not collection_utils::contains(just_pressed_keys, EKey::SPACE) and not just_pressed_keys.empty();
-            // when you type somethign like  "<space>a" we immediately emit the space key before this key so that you
-            // can type at full speed.
-            if (not mapping_mode_active and used_non_space_key and possibly_going_into_mapping_mode) {
-                key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::press_value);
-                key_interceptor.send_key_to_virtual_keyboard(EKey::SPACE, LinuxInputAdapter::release_value);
-                possibly_going_into_mapping_mode = false;
-            }
-
-        } else {
-
-            simultaneous_keypresses.process();
-
-            // when you do space-f and then let go of f we still want to ignore space
-            if (mapping_mode_active) {
-                if (input_state.is_pressed(EKey::SPACE)) {
-                    key_interceptor.keys_to_ignore_this_update.push_back(EKey::SPACE);
-                }
-            }
-
-            if (input_state.is_just_released(EKey::SPACE) and mapping_mode_active) {
-                mapping_mode_active = false;
-                // turn off all possible output keys from the chord mapping so they don't repeat if they were held down
-                // when space was released.
-                for (auto &km : map_name_to_key_map.at(current_mapping).key_mappings) {
-
-                    // leave actively pressed keys on.
-                    if (input_state.is_pressed(km.input_key))
-                        continue;
-
-                    // release all other keys
-                    km.active = false;
-
-                    global_logger->info("about to turn off key: {}",
-                                        input_state.key_enum_to_object.at(km.input_key)->string_repr);
-
-                    // std::cout << "about to turn off key: {}"
-                    //           << input_state.key_enum_to_object.at(km.input_key)->string_repr << std::endl;
-
-                    key_interceptor.send_key_to_virtual_keyboard(km.output_key, LinuxInputAdapter::release_value);
-                }
-            }
-        }
-
-        // TODO: generalize with more stuff later
-        if (mapping_mode_active) {
-            for (auto &cm : map_name_to_key_map.at(current_mapping).key_mappings) {
-                cm.active = true;
-                // transform_input_key_to_output_key(cm.input_key, cm.output_key);
-            }
-        }
-
-        // this does the mappings
-        for (auto &cm : map_name_to_key_map.at(current_mapping).key_mappings) {
-
-            // if you do space-f then don't run the f function
-            if (not cm.active or cm.input_key == key_used_to_start_mapping)
-                continue;
-
-            int value;
-            switch (input_state.get_current_state(cm.input_key)) {
-            case TemporalBinarySwitch::State::just_switched_on:
-                possibly_going_into_mapping_mode = false;
-                value = LinuxInputAdapter::press_value;
-                break;
-            case TemporalBinarySwitch::State::sustained_on:
-                value = LinuxInputAdapter::repeat_value;
-                break;
-            case TemporalBinarySwitch::State::just_switched_off:
-                value = LinuxInputAdapter::release_value;
-                cm.active = false;
-                break;
-            case TemporalBinarySwitch::State::sustained_off:
-                // doesn't need to be modeled by exclusion
-                continue; // we don't even send akey in this case
-                break;
-            }
-
-            global_logger->info("about to turn on key: {}",
-                                input_state.key_enum_to_object.at(cm.input_key)->string_repr);
-
-            key_interceptor.keys_to_ignore_this_update.push_back(cm.input_key);
-
-            key_interceptor.send_key_to_virtual_keyboard(cm.output_key, value);
-            // transform_input_key_to_output_key(cm.input_key, cm.output_key);
-        }
-    }
-};
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 class LinuxTerminalCanvas {
   public:
@@ -719,32 +153,261 @@ class LinuxTerminalCanvas {
     }
 };
 
-int main() {
+volatile std::sig_atomic_t stop_requested = 0;
+volatile std::sig_atomic_t trace_dump_requested = 0;
+volatile std::sig_atomic_t speculative_space_toggle_requested = 0;
+
+int main(int argc, char *argv[]) {
 
     global_logger->remove_all_sinks();
     // global_logger->add_file_sink("logs/logs.txt");
 
-    FixedFrequencyLoop ffl;
-    ChordSystem chord_system;
-
-    auto term = []() { return false; };
-    ffl.logging_enabled = false;
-
-    LinuxTerminalCanvas canvas;
-    canvas.hide_cursor();
-
-    ffl.start(
-        [&](double dt) {
-            chord_system.key_interceptor.update();
-            canvas.render_text_block(0, 0, chord_system.mapping_mode_active ? "mapping" : "not mapping");
-            canvas.render_text_block(0, 20, std::to_string(chord_system.simultaneous_keypresses.last_duration.count()));
-            canvas.render_text_block(10, 4, input_state.get_visual_keyboard_state());
-            canvas.render_text_block(100, 4, virtual_input_state.get_visual_keyboard_state());
-            canvas.draw_arrow(71, 8, 99, 8);
-            // canvas.render_text_block(80, 25, "mapped");
-            canvas.flush();
-        },
-        term);
-
-    canvas.clear();
+    std::string io_backend_name = "poll";
+    bool usage_statistics_enabled = false;
+    bool headless = false;
+    bool publish_state = false;
+    bool event_sourced = false;
+    std::string trace_path;
+    bool measure_latency = false;
+    bool space_tap = false;
+    bool speculative_space = false;
+    std::string injection_socket_path;
+    std::string injection_group;
+    std::vector<std::string> device_paths;
+    int debounce_ms = 0;
+    std::string combo_timings_path;
+    int stall_deadline_ms = 500;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.starts_with("--io-backend=")) {
+            io_backend_name = arg.substr(std::string("--io-backend=").size());
+        } else if (arg == "--stats") {
+            usage_statistics_enabled = true;
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--publish-state") {
+            publish_state = true;
+        } else if (arg == "--event-sourced") {
+            event_sourced = true;
+        } else if (arg.starts_with("--trace=")) {
+            trace_path = arg.substr(std::string("--trace=").size());
+        } else if (arg == "--measure-latency") {
+            measure_latency = true;
+        } else if (arg == "--space-tap") {
+            space_tap = true;
+        } else if (arg == "--speculative-space") {
+            space_tap = true;
+            speculative_space = true;
+        } else if (arg == "--injection-socket") {
+            injection_socket_path = injection::default_socket_path;
+        } else if (arg.starts_with("--injection-socket=")) {
+            injection_socket_path = arg.substr(std::string("--injection-socket=").size());
+        } else if (arg.starts_with("--injection-group=")) {
+            injection_group = arg.substr(std::string("--injection-group=").size());
+        } else if (arg.starts_with("--debounce-ms=")) {
+            debounce_ms = std::stoi(arg.substr(std::string("--debounce-ms=").size()));
+        } else if (arg == "--learn-combo-thresholds") {
+            combo_timings_path = ComboThresholdLearner::default_path;
+        } else if (arg.starts_with("--learn-combo-thresholds=")) {
+            combo_timings_path = arg.substr(std::string("--learn-combo-thresholds=").size());
+        } else if (arg.starts_with("--stall-deadline-ms=")) {
+            stall_deadline_ms = std::stoi(arg.substr(std::string("--stall-deadline-ms=").size()));
+        } else if (arg.starts_with("--device=")) {
+            device_paths.push_back(arg.substr(std::string("--device=").size()));
+        } else {
+            std::cerr << "unknown argument: " << arg << "\n";
+            std::cerr << "usage: key_interceptor [--io-backend=poll|io_uring] [--stats] [--headless] [--publish-state] "
+                         "[--event-sourced] [--trace=path] [--measure-latency] [--space-tap] [--speculative-space] "
+                         "[--injection-socket[=path]] [--injection-group=group] [--device=path]... [--debounce-ms=ms] "
+                         "[--learn-combo-thresholds[=path]] [--stall-deadline-ms=ms]\n";
+            return 1;
+        }
+    }
+
+    auto configure = [&](ChordSystem &chord_system) {
+        chord_system.key_interceptor.set_input_output_backend(create_input_output_backend(io_backend_name));
+        chord_system.key_interceptor.event_sourced = event_sourced;
+        chord_system.space_tap_mapping_activation_mode = space_tap;
+        chord_system.speculative_space = speculative_space;
+        chord_system.key_interceptor.linux_input_adapter.debounce.set_window(std::chrono::milliseconds(debounce_ms));
+    };
+
+    // without --device the keyboard is asked for interactively
+    std::unique_ptr<ChordSystem> chord_system_ptr =
+        device_paths.empty() ? std::make_unique<ChordSystem>()
+                             : std::make_unique<ChordSystem>(device_paths[0], create_virtual_keyboard_device(), true);
+    ChordSystem &chord_system = *chord_system_ptr;
+    configure(chord_system);
+
+    // NOTE: every other device gets a pipeline and virtual keyboard of its own, run on its own thread. Statistics,
+    // snapshots, learned thresholds, latency measurement, injection, the speculative space toggle and the canvas stay
+    // with the first one.
+    std::vector<std::unique_ptr<ChordSystem>> other_chord_systems;
+    for (size_t i = 1; i < device_paths.size(); i++) {
+        other_chord_systems.push_back(
+            std::make_unique<ChordSystem>(device_paths[i], create_virtual_keyboard_device(), true));
+        configure(*other_chord_systems.back());
+    }
+
+    // NOTE: there's no way to know which application has focus from here, so turning it off for the ones where
+    // backspace isn't an undo is left to you, eg bind `pkill -USR2 key_interceptor` to a key in your window manager
+    if (speculative_space)
+        std::signal(SIGUSR2, [](int) { speculative_space_toggle_requested = 1; });
+
+    // read live with key_interceptor_stats, off unless asked for as the counters record what is typed
+    std::unique_ptr<UsageStatistics> usage_statistics;
+    if (usage_statistics_enabled) {
+        usage_statistics = std::make_unique<UsageStatistics>();
+        chord_system.set_usage_statistics(usage_statistics.get());
+    }
+
+    // written back every few minutes and on exit
+    std::unique_ptr<ComboThresholdLearner> combo_threshold_learner;
+    if (not combo_timings_path.empty()) {
+        combo_threshold_learner = std::make_unique<ComboThresholdLearner>(combo_timings_path);
+        chord_system.set_combo_threshold_learner(combo_threshold_learner.get());
+    }
+
+    // reported on exit
+    std::unique_ptr<LatencyMeasurement> latency_measurement;
+    if (measure_latency) {
+        int virtual_keyboard_file_descriptor = chord_system.key_interceptor.virtual_keyboard_file_descriptor;
+        latency_measurement =
+            std::make_unique<LatencyMeasurement>(get_uinput_device_event_path(virtual_keyboard_file_descriptor));
+        chord_system.key_interceptor.set_latency_measurement(latency_measurement.get());
+    }
+
+    // written to by key_interceptor_inject
+    std::unique_ptr<InjectionSocket> injection_socket;
+    if (not injection_socket_path.empty()) {
+        injection_socket = std::make_unique<InjectionSocket>(injection_socket_path);
+        if (not injection_group.empty())
+            injection_socket->allow_group(injection_group);
+        chord_system.key_interceptor.set_injection_socket(injection_socket.get());
+    }
+
+    // read live with key_interceptor_viewer, off unless asked for as the snapshot shows every key being typed
+    std::unique_ptr<StateSnapshotPublisher> state_snapshot_publisher;
+    if (publish_state) {
+        state_snapshot_publisher = std::make_unique<StateSnapshotPublisher>();
+        chord_system.set_state_snapshot_publisher(state_snapshot_publisher.get());
+    }
+
+    // open the trace in chrome://tracing or ui.perfetto.dev, it's written on exit and on SIGUSR1 with a single device
+    if (not trace_path.empty()) {
+        trace::enable();
+        std::signal(SIGUSR1, [](int) { trace_dump_requested = 1; });
+    }
+
+    // NOTE: stopping through the loop instead of being killed lets everything clean up and the trace be written
+    std::signal(SIGINT, [](int) { stop_requested = 1; });
+    std::signal(SIGTERM, [](int) { stop_requested = 1; });
+    auto term = []() { return stop_requested != 0; };
+
+    auto run_until_stopped = [&](ChordSystem &chord_system, auto &&tick) {
+        if (event_sourced) {
+            // NOTE: events are handled as soon as they arrive instead of on the next tick, while nothing is being
+            // typed the loop sleeps until the logic's next timer runs out. It still wakes up regularly to beat the
+            // stall watchdog and to notice a stop request, which only interrupts the wait of the main thread.
+            int max_idle_timeout_ms = stall_deadline_ms > 0 ? std::min(stall_deadline_ms / 4, 100) : 100;
+            while (not term()) {
+                chord_system.key_interceptor.wait_for_input(chord_system.get_idle_timeout_ms(max_idle_timeout_ms));
+                tick();
+            }
+        } else {
+            FixedFrequencyLoop ffl;
+            ffl.logging_enabled = false;
+            ffl.start([&](double dt) { tick(); }, term);
+        }
+    };
+
+    // NOTE: the grab is what makes a stalled loop dangerous, so every pipeline gets a watchdog unless it's turned off
+    // with --stall-deadline-ms=0. They're started right before the loops so the setup above, which can take a while
+    // (eg the latency measurement), doesn't count as a stall, and declared after the pipelines so they stop first.
+    std::vector<std::unique_ptr<StallWatchdog>> stall_watchdogs;
+    if (stall_deadline_ms > 0) {
+        std::vector<ChordSystem *> all_chord_systems = {&chord_system};
+        for (auto &other_chord_system : other_chord_systems)
+            all_chord_systems.push_back(other_chord_system.get());
+
+        for (ChordSystem *pipeline : all_chord_systems) {
+            KeyInterceptor &key_interceptor = pipeline->key_interceptor;
+            stall_watchdogs.push_back(std::make_unique<StallWatchdog>(
+                key_interceptor.linux_input_adapter.get_file_descriptor(),
+                key_interceptor.virtual_keyboard_file_descriptor, std::chrono::milliseconds(stall_deadline_ms)));
+            key_interceptor.set_stall_watchdog(stall_watchdogs.back().get());
+        }
+    }
+
+    std::vector<std::thread> other_pipeline_threads;
+    for (auto &other_chord_system : other_chord_systems) {
+        other_pipeline_threads.emplace_back([&run_until_stopped, &other_chord_system = *other_chord_system]() {
+            run_until_stopped(other_chord_system, [&]() { other_chord_system.key_interceptor.update(); });
+        });
+    }
+
+    // NOTE: in headless mode the input thread never renders, the terminal is left to key_interceptor_viewer
+    std::unique_ptr<LinuxTerminalCanvas> canvas_ptr;
+    if (not headless)
+        canvas_ptr = std::make_unique<LinuxTerminalCanvas>();
+    state_snapshot::Snapshot last_drawn_state{};
+    bool canvas_drawn_at_least_once = false;
+
+    auto tick = [&]() {
+        chord_system.key_interceptor.update();
+        chord_system.publish_state_snapshot();
+
+        if (combo_threshold_learner != nullptr)
+            combo_threshold_learner->save_if_due();
+
+        if (speculative_space_toggle_requested) {
+            speculative_space_toggle_requested = 0;
+            chord_system.speculative_space_paused = not chord_system.speculative_space_paused;
+        }
+
+        // written between ticks, where the input thread isn't recording. The other pipelines record on their own
+        // threads the whole time, so with several devices the trace is only written on exit once they've been joined
+        if (trace_dump_requested) {
+            trace_dump_requested = 0;
+            if (other_chord_systems.empty())
+                trace::write_chrome_trace(trace_path);
+            else
+                std::cerr << "with several devices the trace is only written on exit\n";
+        }
+
+        if (headless)
+            return;
+
+        // NOTE: redrawing is far more expensive than the tick, so it's only done when what it shows changed
+        state_snapshot::Snapshot drawn_state = chord_system.get_state_snapshot();
+        if (canvas_drawn_at_least_once and memcmp(&drawn_state, &last_drawn_state, sizeof(drawn_state)) == 0)
+            return;
+        last_drawn_state = drawn_state;
+        canvas_drawn_at_least_once = true;
+
+        LinuxTerminalCanvas &canvas = *canvas_ptr;
+        canvas.render_text_block(0, 0, chord_system.mapping_mode_active ? "mapping" : "not mapping");
+        canvas.render_text_block(0, 20, std::to_string(chord_system.simultaneous_keypresses.last_duration.count()));
+        canvas.render_text_block(10, 4, chord_system.input_state.get_visual_keyboard_state());
+        canvas.render_text_block(100, 4, chord_system.key_interceptor.virtual_input_state.get_visual_keyboard_state());
+        canvas.draw_arrow(71, 8, 99, 8);
+        // canvas.render_text_block(80, 25, "mapped");
+        canvas.flush();
+    };
+
+    run_until_stopped(chord_system, tick);
+    for (std::thread &other_pipeline_thread : other_pipeline_threads)
+        other_pipeline_thread.join();
+
+    if (not trace_path.empty())
+        trace::write_chrome_trace(trace_path);
+
+    if (combo_threshold_learner != nullptr)
+        combo_threshold_learner->save();
+
+    if (latency_measurement != nullptr) {
+        // the canvas clears the terminal when it goes away
+        canvas_ptr.reset();
+        latency_measurement->report(std::cout);
+    }
 }
@@ -0,0 +1,177 @@
+#include "mouse_keys.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+MouseKeys::MouseKeys(Settings settings) : settings(settings) {
+
+    timer_file_descriptor = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_file_descriptor < 0) {
+        throw std::runtime_error("Failed to create mouse keys timer");
+    }
+
+    wake_up_file_descriptor = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_up_file_descriptor < 0) {
+        close(timer_file_descriptor);
+        throw std::runtime_error("Failed to create mouse keys wake up eventfd");
+    }
+
+    motion_thread = std::thread([this]() { run(); });
+}
+
+MouseKeys::~MouseKeys() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop_requested = true;
+        direction_x = 0;
+        direction_y = 0;
+        direction_scroll = 0;
+    }
+    direction_changed.notify_one();
+
+    if (motion_thread.joinable())
+        motion_thread.join();
+
+    close(timer_file_descriptor);
+    close(wake_up_file_descriptor);
+}
+
+void MouseKeys::set_direction(int x, int y, int scroll) {
+    if (direction_x == x and direction_y == y and direction_scroll == scroll)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        direction_x = x;
+        direction_y = y;
+        direction_scroll = scroll;
+    }
+    direction_changed.notify_one();
+}
+
+bool MouseKeys::is_moving() const { return direction_x != 0 or direction_y != 0 or direction_scroll != 0; }
+
+MouseKeys::Motion MouseKeys::take_motion() {
+    if (not motion_pending.exchange(false))
+        return {};
+
+    // NOTE: drained before the motion is taken, motion added after this writes the eventfd again so it isn't missed
+    uint64_t num_wake_ups;
+    [[maybe_unused]] ssize_t result = read(wake_up_file_descriptor, &num_wake_ups, sizeof(num_wake_ups));
+
+    Motion motion;
+    motion.x = pending_x.exchange(0);
+    motion.y = pending_y.exchange(0);
+    motion.wheel = pending_wheel.exchange(0);
+    motion.wheel_hi_res = pending_wheel_hi_res.exchange(0);
+    return motion;
+}
+
+void MouseKeys::add_pending_motion(int x, int y, int wheel, int wheel_hi_res) {
+    if (x == 0 and y == 0 and wheel == 0 and wheel_hi_res == 0)
+        return;
+
+    pending_x += x;
+    pending_y += y;
+    pending_wheel += wheel;
+    pending_wheel_hi_res += wheel_hi_res;
+
+    if (not motion_pending.exchange(true)) {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t result = write(wake_up_file_descriptor, &one, sizeof(one));
+    }
+}
+
+double MouseKeys::speed_after_holding_for(double seconds_held) const {
+    double progress = settings.seconds_to_max_speed > 0 ? std::min(seconds_held / settings.seconds_to_max_speed, 1.0)
+                                                        : 1.0;
+
+    switch (settings.acceleration_curve) {
+    case AccelerationCurve::constant:
+        return settings.max_speed;
+    case AccelerationCurve::linear:
+        break;
+    case AccelerationCurve::quadratic:
+        progress = progress * progress;
+        break;
+    }
+
+    return settings.initial_speed + (settings.max_speed - settings.initial_speed) * progress;
+}
+
+void MouseKeys::arm_timer(bool armed) {
+    struct itimerspec spec{};
+    if (armed) {
+        long period_ns = static_cast<long>(1e9 / settings.update_rate_hz);
+        spec.it_interval.tv_sec = period_ns / 1000000000;
+        spec.it_interval.tv_nsec = period_ns % 1000000000;
+        spec.it_value = spec.it_interval;
+    }
+    timerfd_settime(timer_file_descriptor, 0, &spec, nullptr);
+}
+
+void MouseKeys::run() {
+    using Clock = std::chrono::steady_clock;
+
+    // wheel motion in hi-res units, 120 of them make up one detent of a regular wheel
+    const int hi_res_units_per_detent = 120;
+
+    while (true) {
+        {
+            // NOTE: this is where the thread spends all of its time when no mouse key is held
+            std::unique_lock<std::mutex> lock(mutex);
+            direction_changed.wait(lock, [this]() { return stop_requested or is_moving(); });
+            if (stop_requested)
+                return;
+        }
+
+        // sub pixel remainders are carried between ticks so slow speeds still move smoothly
+        double remainder_x = 0, remainder_y = 0, remainder_scroll = 0;
+        int hi_res_scroll_since_last_detent = 0;
+
+        Clock::time_point motion_start_time = Clock::now();
+        Clock::time_point last_tick_time = motion_start_time;
+        arm_timer(true);
+
+        while (is_moving()) {
+            uint64_t expirations;
+            if (read(timer_file_descriptor, &expirations, sizeof(expirations)) != sizeof(expirations))
+                continue;
+
+            Clock::time_point now = Clock::now();
+            double dt = std::chrono::duration<double>(now - last_tick_time).count();
+            double seconds_held = std::chrono::duration<double>(now - motion_start_time).count();
+            last_tick_time = now;
+
+            double distance = speed_after_holding_for(seconds_held) * dt;
+            // moving diagonally shouldn't be faster than moving along an axis
+            if (direction_x != 0 and direction_y != 0)
+                distance /= std::sqrt(2.0);
+
+            remainder_x += direction_x * distance;
+            remainder_y += direction_y * distance;
+            remainder_scroll += direction_scroll * settings.scroll_speed * hi_res_units_per_detent * dt;
+
+            int x = static_cast<int>(remainder_x);
+            int y = static_cast<int>(remainder_y);
+            int hi_res_scroll = static_cast<int>(remainder_scroll);
+            remainder_x -= x;
+            remainder_y -= y;
+            remainder_scroll -= hi_res_scroll;
+
+            // legacy clients only understand whole detents so we emit one every time enough hi-res motion accumulated
+            hi_res_scroll_since_last_detent += hi_res_scroll;
+            int detents = hi_res_scroll_since_last_detent / hi_res_units_per_detent;
+            hi_res_scroll_since_last_detent -= detents * hi_res_units_per_detent;
+
+            add_pending_motion(x, y, detents, hi_res_scroll);
+        }
+
+        arm_timer(false);
+    }
+}
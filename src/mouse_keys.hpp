@@ -0,0 +1,92 @@
+#ifndef MOUSE_KEYS_HPP
+#define MOUSE_KEYS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief moves the pointer and scrolls while a direction is held, the motion is driven by its own high resolution timer
+ * (timerfd) so that it stays smooth no matter how fast the main loop ticks. When no direction is held the timer is
+ * disarmed and the thread sleeps so it costs nothing.
+ *
+ * The thread only accumulates the motion, the loop takes it with take_motion and sends it through its output sink like
+ * every other event. The wake up file descriptor becomes readable whenever there is motion to take, so a loop that
+ * waits for input can wake up for it.
+ */
+class MouseKeys {
+  public:
+    enum class AccelerationCurve {
+        constant,
+        linear,
+        quadratic,
+    };
+
+    struct Settings {
+        // how often motion events are emitted while a direction is held
+        double update_rate_hz = 500;
+        // pointer speed in pixels per second
+        double initial_speed = 150;
+        double max_speed = 1500;
+        // how long a direction has to be held before max_speed is reached
+        double seconds_to_max_speed = 0.7;
+        AccelerationCurve acceleration_curve = AccelerationCurve::quadratic;
+        // wheel detents per second, emitted in hi-res units so scrolling is smooth as well
+        double scroll_speed = 12;
+    };
+
+    // the motion in one take_motion, wheel in detents and wheel_hi_res in 1/120ths of one
+    struct Motion {
+        int x = 0, y = 0, wheel = 0, wheel_hi_res = 0;
+        bool empty() const { return x == 0 and y == 0 and wheel == 0 and wheel_hi_res == 0; }
+    };
+
+    MouseKeys() : MouseKeys(Settings()) {}
+    explicit MouseKeys(Settings settings);
+    ~MouseKeys();
+
+    Settings settings;
+
+    /**
+     * @brief each component is -1, 0 or 1, calling this with all zeros stops the motion. Safe to call every tick, it
+     * only wakes the motion thread when the direction actually changes.
+     */
+    void set_direction(int x, int y, int scroll);
+
+    bool is_moving() const;
+
+    // the motion accumulated since the last call, cheap when there is none
+    Motion take_motion();
+
+    int get_wake_up_file_descriptor() const { return wake_up_file_descriptor; }
+
+  private:
+    int timer_file_descriptor = -1;
+    // an eventfd, written when motion becomes pending and drained by take_motion
+    int wake_up_file_descriptor = -1;
+
+    std::atomic<int> pending_x{0};
+    std::atomic<int> pending_y{0};
+    std::atomic<int> pending_wheel{0};
+    std::atomic<int> pending_wheel_hi_res{0};
+    std::atomic<bool> motion_pending{false};
+
+    std::atomic<int> direction_x{0};
+    std::atomic<int> direction_y{0};
+    std::atomic<int> direction_scroll{0};
+
+    std::mutex mutex;
+    std::condition_variable direction_changed;
+    bool stop_requested = false;
+
+    std::thread motion_thread;
+
+    double speed_after_holding_for(double seconds_held) const;
+    void arm_timer(bool armed);
+    void add_pending_motion(int x, int y, int wheel, int wheel_hi_res);
+    void run();
+};
+
+#endif // MOUSE_KEYS_HPP
@@ -0,0 +1,17 @@
+#include "output_sink.hpp"
+
+#include <utility>
+
+void InMemoryOutputSink::flush() {
+    if (queued_events.empty())
+        return;
+
+    std::lock_guard lock(mutex);
+    flushed_events.insert(flushed_events.end(), queued_events.begin(), queued_events.end());
+    queued_events.clear();
+}
+
+std::vector<struct input_event> InMemoryOutputSink::take_events() {
+    std::lock_guard lock(mutex);
+    return std::exchange(flushed_events, {});
+}
@@ -0,0 +1,64 @@
+#ifndef OUTPUT_SINK_HPP
+#define OUTPUT_SINK_HPP
+
+#include "input_output_backend.hpp"
+
+#include <linux/input.h>
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief where a key interceptor sends the events for its virtual keyboard, write_events only queues them and flush
+ * hands everything queued over at once
+ */
+class OutputSink {
+  public:
+    virtual ~OutputSink() = default;
+
+    virtual void write_events(const struct input_event *events, size_t num_events) = 0;
+    virtual void flush() = 0;
+};
+
+/**
+ * @brief a uinput virtual keyboard (or anything else that is written like one, eg /dev/null) written through an
+ * InputOutputBackend
+ */
+class UinputOutputSink : public OutputSink {
+  public:
+    // the backend must outlive the sink
+    UinputOutputSink(InputOutputBackend &input_output_backend, int file_descriptor)
+        : input_output_backend(input_output_backend), file_descriptor(file_descriptor) {}
+
+    void write_events(const struct input_event *events, size_t num_events) override {
+        input_output_backend.write_events(file_descriptor, events, num_events);
+    }
+    void flush() override { input_output_backend.flush(); }
+
+  private:
+    InputOutputBackend &input_output_backend;
+    int file_descriptor;
+};
+
+/**
+ * @brief keeps everything that was flushed in memory, take_events may be called from any thread
+ */
+class InMemoryOutputSink : public OutputSink {
+  public:
+    void write_events(const struct input_event *events, size_t num_events) override {
+        queued_events.insert(queued_events.end(), events, events + num_events);
+    }
+    void flush() override;
+
+    // everything flushed since the last call
+    std::vector<struct input_event> take_events();
+
+  private:
+    std::vector<struct input_event> queued_events;
+
+    std::mutex mutex;
+    std::vector<struct input_event> flushed_events;
+};
+
+#endif // OUTPUT_SINK_HPP
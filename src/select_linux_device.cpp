@@ -135,7 +135,51 @@ void send_key(int ufd, int key, int value) {
     write(ufd, &ev, sizeof(ev));
 }
 
-int create_virtual_keyboard_device() {
+size_t make_relative_motion_events(struct input_event events[7], int x, int y, int wheel, int hwheel,
+                                   int wheel_hi_res, int hwheel_hi_res) {
+    // one event per axis that moved plus the SYN_REPORT
+    memset(events, 0, 7 * sizeof(struct input_event));
+    size_t num_events = 0;
+
+    auto add_event = [&](int code, int value) {
+        if (value == 0)
+            return;
+        events[num_events].type = EV_REL;
+        events[num_events].code = code;
+        events[num_events].value = value;
+        num_events++;
+    };
+
+    add_event(REL_X, x);
+    add_event(REL_Y, y);
+    add_event(REL_WHEEL, wheel);
+    add_event(REL_HWHEEL, hwheel);
+    add_event(REL_WHEEL_HI_RES, wheel_hi_res);
+    add_event(REL_HWHEEL_HI_RES, hwheel_hi_res);
+
+    if (num_events == 0)
+        return 0;
+
+    events[num_events].type = EV_SYN;
+    events[num_events].code = SYN_REPORT;
+    events[num_events].value = 0;
+    num_events++;
+
+    return num_events;
+}
+
+void send_relative_motion(int ufd, int x, int y, int wheel, int hwheel, int wheel_hi_res, int hwheel_hi_res) {
+    struct input_event events[7];
+    size_t num_events = make_relative_motion_events(events, x, y, wheel, hwheel, wheel_hi_res, hwheel_hi_res);
+    if (num_events == 0)
+        return;
+
+    write(ufd, events, num_events * sizeof(struct input_event));
+}
+
+int create_virtual_keyboard_device() { return create_virtual_keyboard_device("Forwarded Virtual Keyboard"); }
+
+int create_virtual_keyboard_device(const std::string &name) {
     int ufd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
     if (ufd < 0) {
         perror("open /dev/uinput");
@@ -144,18 +188,47 @@ int create_virtual_keyboard_device() {
 
     ioctl(ufd, UI_SET_EVBIT, EV_KEY);
     ioctl(ufd, UI_SET_EVBIT, EV_SYN);
+    ioctl(ufd, UI_SET_EVBIT, EV_REL);
 
+    // NOTE: this range also covers BTN_LEFT, BTN_RIGHT and BTN_MIDDLE so mouse buttons are forwarded like any other key
     for (int k = 0; k < KEY_MAX; k++)
         ioctl(ufd, UI_SET_KEYBIT, k);
 
+    for (int rel : {REL_X, REL_Y, REL_WHEEL, REL_HWHEEL, REL_WHEEL_HI_RES, REL_HWHEEL_HI_RES})
+        ioctl(ufd, UI_SET_RELBIT, rel);
+
     struct uinput_setup us;
     memset(&us, 0, sizeof(us));
     us.id.bustype = BUS_USB;
     us.id.vendor = 0x1234;
     us.id.product = 0x5678;
-    strcpy(us.name, "Forwarded Virtual Keyboard");
+    strncpy(us.name, name.c_str(), UINPUT_MAX_NAME_SIZE - 1);
 
     ioctl(ufd, UI_DEV_SETUP, &us);
     ioctl(ufd, UI_DEV_CREATE);
     return ufd;
 }
+
+std::string get_uinput_device_event_path(int ufd) {
+    char sysname[64] = {};
+    if (ioctl(ufd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) {
+        perror("UI_GET_SYSNAME");
+        return "";
+    }
+
+    std::string sys_path = std::string("/sys/devices/virtual/input/") + sysname;
+    DIR *dir = opendir(sys_path.c_str());
+    if (!dir)
+        return "";
+
+    std::string event_path;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strncmp(entry->d_name, "event", 5) == 0) {
+            event_path = std::string("/dev/input/") + entry->d_name;
+            break;
+        }
+    }
+    closedir(dir);
+    return event_path;
+}
@@ -31,6 +31,20 @@ std::string interactively_select_linux_device_name();
 
 void send_key(int ufd, int key, int value);
 
+// fills events with a single SYN frame holding the given deltas, axes with a zero delta are skipped, returns the number
+// of events used (0 if nothing moved)
+size_t make_relative_motion_events(struct input_event events[7], int x, int y, int wheel, int hwheel,
+                                   int wheel_hi_res, int hwheel_hi_res);
+
+// sends the given deltas as a single SYN frame with one write
+void send_relative_motion(int ufd, int x, int y, int wheel, int hwheel, int wheel_hi_res, int hwheel_hi_res);
+
 int create_virtual_keyboard_device();
+// a virtual device with every key and relative axis, the name is what shows up in /proc/bus/input/devices
+int create_virtual_keyboard_device(const std::string &name);
+
+// the /dev/input/eventN node of a device created through uinput, so a program can read back what it created, returns
+// an empty string if it can't be found (eg udev hasn't created the node yet)
+std::string get_uinput_device_event_path(int ufd);
 
 #endif // SELECT_LINUX_DEVICE_HPP
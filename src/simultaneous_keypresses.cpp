@@ -0,0 +1,6 @@
+#include "simultaneous_keypresses.hpp"
+
+size_t SimultaneousKeypresses::register_combo(EKey key1, EKey key2) {
+    combos.push_back({key1, key2, threshold});
+    return combos.size() - 1;
+}
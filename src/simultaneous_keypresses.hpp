@@ -0,0 +1,118 @@
+#ifndef SIMULTANEOUS_KEYPRESSES_HPP
+#define SIMULTANEOUS_KEYPRESSES_HPP
+
+#include "combo_threshold_learner.hpp"
+#include "key_interceptor.hpp"
+#include "usage_statistics.hpp"
+
+#include <chrono>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+struct SimultaneousKeypresses {
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+
+    KeyInterceptor &key_interceptor;
+
+    SimultaneousKeypresses(std::chrono::milliseconds t, KeyInterceptor &key_interceptor)
+        : threshold(t), key_interceptor(key_interceptor) {}
+
+    // what a combo does when it fires is up to the caller of process, which is told the index of the combo
+    struct Combo {
+        EKey key1;
+        EKey key2;
+        // starts out as the threshold below, a combo threshold learner moves it to fit how you type
+        std::chrono::milliseconds threshold;
+
+        // from the second press of an attempt until one of its keys comes back up, only tracked while learning
+        std::optional<TimePoint> attempt_second_press_time;
+        std::chrono::milliseconds attempt_gap{0};
+    };
+
+    // the threshold new combos start with
+    std::chrono::milliseconds threshold;
+    std::unordered_map<EKey, TimePoint> key_pressed_times;
+    std::vector<Combo> combos;
+
+    std::chrono::milliseconds last_duration{0};
+
+    // optional, when set every combo attempt is counted along with the gap between its two keys
+    UsageStatistics *usage_statistics = nullptr;
+
+    // optional, when set every attempt is classified as a chord or a roll once it's over and the combo's threshold is
+    // updated from what was learned
+    ComboThresholdLearner *combo_threshold_learner = nullptr;
+
+    // returns the index that process passes to on_combo_fired when this combo fires
+    size_t register_combo(EKey key1, EKey key2);
+
+    /**
+     * @brief call this every update, on_combo_fired(combo_index) is called for every combo whose keys went down within
+     * its threshold of each other. It's a template parameter so the call can be inlined, unlike a stored std::function.
+     */
+    template <typename OnComboFired> void process(OnComboFired &&on_combo_fired);
+};
+
+template <typename OnComboFired> void SimultaneousKeypresses::process(OnComboFired &&on_combo_fired) {
+    InputState &input_state = key_interceptor.input_state;
+
+    // record timestamps for keys that were just pressed
+    for (auto &combo : combos) {
+        for (EKey key : {combo.key1, combo.key2}) {
+            if (input_state.get_current_state(key) == TemporalBinarySwitch::State::just_switched_on) {
+                // NOTE: in event sourced mode this is when the key really went down, not when it was read
+                key_pressed_times[key] = key_interceptor.get_current_time();
+            }
+        }
+    }
+
+    // check all combos
+    for (size_t combo_index = 0; combo_index < combos.size(); combo_index++) {
+        auto &combo = combos[combo_index];
+        bool both_pressed = input_state.is_pressed(combo.key1) and input_state.is_pressed(combo.key2);
+
+        if (combo.attempt_second_press_time.has_value() and not both_pressed) {
+            auto overlap = std::chrono::duration_cast<std::chrono::milliseconds>(key_interceptor.get_current_time() -
+                                                                                 *combo.attempt_second_press_time);
+            combo.attempt_second_press_time.reset();
+            if (combo_threshold_learner != nullptr) {
+                combo_threshold_learner->record(combo_index, combo.attempt_gap, overlap);
+                if (auto learned_threshold = combo_threshold_learner->get_learned_threshold(combo_index))
+                    combo.threshold = *learned_threshold;
+            }
+        }
+
+        if (both_pressed) {
+            auto it1 = key_pressed_times.find(combo.key1);
+            auto it2 = key_pressed_times.find(combo.key2);
+
+            if (it1 != key_pressed_times.end() && it2 != key_pressed_times.end()) {
+                auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(it2->second - it1->second);
+                auto abs_duration = std::chrono::milliseconds(std::abs(duration.count()));
+                last_duration = abs_duration;
+
+                // an attempt is only counted on the tick its second key went down, not for as long as both are held
+                bool attempt_started_this_tick =
+                    input_state.is_just_pressed(combo.key1) or input_state.is_just_pressed(combo.key2);
+                if (usage_statistics != nullptr and attempt_started_this_tick)
+                    usage_statistics->record_combo_attempt(combo_index, abs_duration, abs_duration < combo.threshold);
+                if (combo_threshold_learner != nullptr and attempt_started_this_tick) {
+                    combo.attempt_second_press_time = key_interceptor.get_current_time();
+                    combo.attempt_gap = abs_duration;
+                }
+
+                if (abs_duration.count() >= 0 && abs_duration < combo.threshold) {
+                    on_combo_fired(combo_index);
+
+                    // Optionally ignore keys for this update
+                    key_interceptor.keys_to_ignore_this_update.push_back(combo.key1);
+                    key_interceptor.keys_to_ignore_this_update.push_back(combo.key2);
+                }
+            }
+        }
+    }
+}
+
+#endif // SIMULTANEOUS_KEYPRESSES_HPP
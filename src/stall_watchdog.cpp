@@ -0,0 +1,96 @@
+#include "stall_watchdog.hpp"
+
+#include "utility/logger/logger.hpp"
+
+#include <linux/input.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+StallWatchdog::StallWatchdog(int input_file_descriptor, int virtual_keyboard_file_descriptor,
+                             std::chrono::milliseconds deadline)
+    : input_file_descriptor(input_file_descriptor), virtual_keyboard_file_descriptor(virtual_keyboard_file_descriptor),
+      deadline(deadline), last_beat_ns(now_ns()) {
+    thread = std::thread([this]() { run(); });
+}
+
+StallWatchdog::~StallWatchdog() {
+    {
+        std::lock_guard lock(mutex);
+        stop_requested = true;
+    }
+    stop_condition.notify_one();
+    thread.join();
+}
+
+KeyBitmap StallWatchdog::get_held_keys() const {
+    KeyBitmap keys;
+    for (size_t i = 0; i < KeyBitmap::num_words; i++)
+        keys.words[i] = held_keys[i].load(std::memory_order_relaxed);
+    return keys;
+}
+
+void StallWatchdog::run() {
+    // NOTE: checking four times per deadline bounds how long a stall goes unnoticed to a quarter of the deadline
+    auto check_interval = std::max(deadline / 4, std::chrono::milliseconds(1));
+    int64_t deadline_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline).count();
+
+    std::unique_lock lock(mutex);
+    while (not stop_condition.wait_for(lock, check_interval, [this]() { return stop_requested; })) {
+        if (keyboard_released.load(std::memory_order_acquire))
+            continue;
+
+        if (now_ns() - last_beat_ns.load(std::memory_order_relaxed) > deadline_ns)
+            release_keyboard();
+    }
+}
+
+void StallWatchdog::release_keyboard() {
+    // NOTE: the keyboard is given back before anything is logged, a log sink can be what stalled the loop. Without a
+    // device (eg an InMemoryInputSource) there's nothing to give back.
+    if (input_file_descriptor >= 0 and ioctl(input_file_descriptor, EVIOCGRAB, 0) < 0)
+        perror("EVIOCGRAB release");
+
+    if (virtual_keyboard_file_descriptor >= 0)
+        write_releases();
+
+    keyboard_released.store(true, std::memory_order_release);
+    num_stalls.fetch_add(1, std::memory_order_relaxed);
+    global_logger->warn("the input loop stalled for over {}ms, gave the keyboard back to the os", deadline.count());
+}
+
+/*
+ * NOTE: the releases are written straight to the virtual keyboard on purpose instead of through the loop's
+ * OutputSink. The sink belongs to the stalled thread and may be what stalled (eg a write stuck in flight), so going
+ * around it is the only way to get the keys up. That means these writes are neither traced nor measured, and with
+ * the io_uring backend they can land next to a write the loop still has in flight, which is why the loop releases
+ * everything it sent once more when it recovers, see KeyInterceptor::check_in_with_stall_watchdog. Without a
+ * virtual keyboard device (eg an InMemoryOutputSink) there's nothing to write to and that release is all there is.
+ */
+void StallWatchdog::write_releases() {
+    // NOTE: the held keys are taken and cleared at once, so a key the loop sends after this is released again when it
+    // recovers instead of being lost
+    std::vector<struct input_event> events;
+    for (size_t i = 0; i < KeyBitmap::num_words; i++) {
+        KeyBitmap word_keys;
+        word_keys.words[i] = held_keys[i].exchange(0, std::memory_order_relaxed);
+        word_keys.for_each_set_key([&](int linux_code) {
+            struct input_event ev = {};
+            ev.type = EV_KEY;
+            ev.code = linux_code;
+            ev.value = 0;
+            events.push_back(ev);
+        });
+    }
+    if (not events.empty()) {
+        struct input_event syn = {};
+        syn.type = EV_SYN;
+        syn.code = SYN_REPORT;
+        events.push_back(syn);
+        if (write(virtual_keyboard_file_descriptor, events.data(), events.size() * sizeof(struct input_event)) < 0)
+            perror("write releases to the virtual keyboard");
+    }
+}
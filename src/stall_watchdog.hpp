@@ -0,0 +1,85 @@
+#ifndef STALL_WATCHDOG_HPP
+#define STALL_WATCHDOG_HPP
+
+#include "input/linux_input_adapter/key_bitmap.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief gives the keyboard back to the os when the loop that forwards it stalls (a slow terminal, a debugger, a
+ * blocked log sink), so a grabbed keyboard is never dead for longer than the deadline.
+ *
+ * The loop calls beat once per update. When a beat is later than the deadline the watchdog's thread releases the grab
+ * and releases every key that is down on the virtual keyboard, the keyboard then types straight into the os. Getting
+ * it back is up to the loop, see KeyInterceptor::check_in_with_stall_watchdog.
+ *
+ * NOTE: everything the loop and the watchdog's thread share is atomic, the loop never waits on the watchdog
+ */
+class StallWatchdog {
+  public:
+    StallWatchdog(int input_file_descriptor, int virtual_keyboard_file_descriptor, std::chrono::milliseconds deadline);
+    ~StallWatchdog();
+
+    StallWatchdog(const StallWatchdog &) = delete;
+    StallWatchdog &operator=(const StallWatchdog &) = delete;
+
+    // call once per update, returns true while the keyboard has been given back to the os
+    bool beat() {
+        last_beat_ns.store(now_ns(), std::memory_order_relaxed);
+        return keyboard_released.load(std::memory_order_acquire);
+    }
+
+    // call for every key event sent to the virtual keyboard, so the watchdog knows which keys to release
+    void note_key_sent(int linux_code, int value) {
+        // NOTE: a repeat (2) doesn't change what's held
+        if (value == 2)
+            return;
+        uint64_t bit = uint64_t(1) << (linux_code % 64);
+        if (value != 0)
+            held_keys[linux_code / 64].fetch_or(bit, std::memory_order_relaxed);
+        else
+            held_keys[linux_code / 64].fetch_and(~bit, std::memory_order_relaxed);
+    }
+
+    // the keys down on the virtual keyboard as far as the watchdog knows
+    KeyBitmap get_held_keys() const;
+
+    // the loop grabbed the keyboard again, the watchdog goes back to watching
+    void keyboard_regrabbed() { keyboard_released.store(false, std::memory_order_release); }
+
+    size_t get_num_stalls() const { return num_stalls.load(std::memory_order_relaxed); }
+
+  private:
+    void run();
+    void release_keyboard();
+    void write_releases();
+
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    int input_file_descriptor;
+    int virtual_keyboard_file_descriptor;
+    std::chrono::milliseconds deadline;
+
+    std::atomic<int64_t> last_beat_ns;
+    std::atomic<bool> keyboard_released = false;
+    std::array<std::atomic<uint64_t>, KeyBitmap::num_words> held_keys{};
+    std::atomic<size_t> num_stalls = 0;
+
+    std::mutex mutex;
+    std::condition_variable stop_condition;
+    bool stop_requested = false;
+    std::thread thread;
+};
+
+#endif // STALL_WATCHDOG_HPP
@@ -0,0 +1,104 @@
+#include "state_snapshot.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace state_snapshot;
+
+std::optional<Snapshot> state_snapshot::read_snapshot(const SharedStateSnapshot &shared) {
+    uint64_t words[num_snapshot_words];
+
+    for (int attempt = 0; attempt < max_read_attempts; attempt++) {
+        uint64_t sequence_before = shared.sequence.load(std::memory_order_acquire);
+        if (sequence_before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < num_snapshot_words; i++)
+            words[i] = shared.snapshot_words[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shared.sequence.load(std::memory_order_relaxed) == sequence_before) {
+            Snapshot snapshot;
+            memcpy(&snapshot, words, sizeof(snapshot));
+            return snapshot;
+        }
+    }
+
+    return std::nullopt;
+}
+
+StateSnapshotPublisher::StateSnapshotPublisher(const std::string &shared_memory_name) {
+    // NOTE: the snapshot shows every key being typed, so it's always created anew with no permissions for anyone else.
+    // Reusing whatever has the name would publish into a segment another user may have created and still has mapped,
+    // changing its mode wouldn't take that mapping away. If someone creates it again in between, O_EXCL fails.
+    shm_unlink(shared_memory_name.c_str());
+    mode_t previous_umask = umask(0077);
+    int fd = shm_open(shared_memory_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    umask(previous_umask);
+    if (fd < 0) {
+        perror("shm_open state snapshot");
+        return;
+    }
+
+    if (ftruncate(fd, sizeof(SharedStateSnapshot)) < 0) {
+        perror("ftruncate state snapshot");
+        close(fd);
+        return;
+    }
+
+    void *address = mmap(nullptr, sizeof(SharedStateSnapshot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        perror("mmap state snapshot");
+        return;
+    }
+
+    // unlike the usage statistics nothing is worth keeping from a previous run
+    memset(address, 0, sizeof(SharedStateSnapshot));
+    shared = new (address) SharedStateSnapshot();
+    shared->magic = magic;
+    shared->version = version;
+}
+
+StateSnapshotPublisher::~StateSnapshotPublisher() {
+    if (shared != nullptr)
+        munmap(shared, sizeof(SharedStateSnapshot));
+}
+
+void StateSnapshotPublisher::set_layer_name(size_t layer, const std::string &name) {
+    if (shared == nullptr or layer >= max_layers)
+        return;
+
+    strncpy(shared->layer_names[layer], name.c_str(), max_layer_name_length - 1);
+}
+
+void StateSnapshotPublisher::publish(const Snapshot &snapshot) {
+    if (shared == nullptr)
+        return;
+
+    if (published_at_least_once and memcmp(&snapshot, &last_published_snapshot, sizeof(Snapshot)) == 0)
+        return;
+
+    uint64_t words[num_snapshot_words];
+    memcpy(words, &snapshot, sizeof(Snapshot));
+
+    uint64_t sequence = shared->sequence.load(std::memory_order_relaxed);
+    shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (size_t i = 0; i < num_snapshot_words; i++)
+        shared->snapshot_words[i].store(words[i], std::memory_order_relaxed);
+
+    shared->sequence.store(sequence + 2, std::memory_order_release);
+
+    last_published_snapshot = snapshot;
+    published_at_least_once = true;
+}
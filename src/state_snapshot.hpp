@@ -0,0 +1,101 @@
+#ifndef STATE_SNAPSHOT_HPP
+#define STATE_SNAPSHOT_HPP
+
+#include <linux/input-event-codes.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+/**
+ * @brief a compact binary snapshot of the interceptor's state, published through a seqlock in /dev/shm so that a
+ * viewer process (key_interceptor_viewer) can render it at its own pace while the interceptor runs headless.
+ *
+ * There is a single writer, the input thread, which never waits on readers. A reader copies the snapshot and retries if
+ * the sequence number changed while it was copying (or was odd, meaning a write was in progress).
+ */
+namespace state_snapshot {
+
+inline constexpr const char *default_shared_memory_name = "/key_interceptor_state";
+inline constexpr uint32_t magic = 0x4b49534e; // "KISN"
+inline constexpr uint32_t version = 1;
+
+inline constexpr size_t num_key_bitmap_words = (KEY_CNT + 63) / 64;
+inline constexpr size_t max_layers = 16;
+inline constexpr size_t max_layer_name_length = 32;
+inline constexpr size_t max_layer_stack_depth = 8;
+
+enum ModeFlag : uint32_t {
+    mapping_mode_active = 1 << 0,
+    space_tap_mapping_activation_mode = 1 << 1,
+    possibly_going_into_mapping_mode = 1 << 2,
+};
+
+// key bitmaps are indexed by linux key code
+struct Snapshot {
+    uint64_t physical_keys[num_key_bitmap_words];
+    uint64_t virtual_keys[num_key_bitmap_words];
+    uint8_t layer_stack[max_layer_stack_depth];
+    uint32_t layer_stack_depth;
+    uint32_t mode_flags;
+    uint32_t last_combo_gap_ms;
+    uint32_t padding;
+
+    void set_key(uint64_t (&bitmap)[num_key_bitmap_words], int linux_code) {
+        bitmap[linux_code / 64] |= uint64_t(1) << (linux_code % 64);
+    }
+
+    static bool is_key_set(const uint64_t (&bitmap)[num_key_bitmap_words], int linux_code) {
+        return bitmap[linux_code / 64] & (uint64_t(1) << (linux_code % 64));
+    }
+};
+
+static_assert(sizeof(Snapshot) % sizeof(uint64_t) == 0, "the snapshot is copied one 64 bit word at a time");
+inline constexpr size_t num_snapshot_words = sizeof(Snapshot) / sizeof(uint64_t);
+
+struct SharedStateSnapshot {
+    uint32_t magic;
+    uint32_t version;
+    char layer_names[max_layers][max_layer_name_length];
+
+    // odd while the writer is in the middle of an update
+    alignas(64) std::atomic<uint64_t> sequence;
+    // NOTE: stored as atomic words so that a reader copying during a write is a retry and not a data race
+    alignas(64) std::atomic<uint64_t> snapshot_words[num_snapshot_words];
+};
+
+// a write takes well under a microsecond, a sequence that stays odd for longer means the writer died during one
+inline constexpr int max_read_attempts = 10000;
+
+/**
+ * @brief copies the latest consistent snapshot out of shared memory, retrying only while a write is in progress. Empty
+ * when no consistent copy could be made within max_read_attempts.
+ */
+std::optional<Snapshot> read_snapshot(const SharedStateSnapshot &shared);
+
+} // namespace state_snapshot
+
+/**
+ * @brief the writing side, owned by the input thread. If the shared memory can't be mapped publishing is a no-op.
+ */
+class StateSnapshotPublisher {
+  public:
+    StateSnapshotPublisher(const std::string &shared_memory_name = state_snapshot::default_shared_memory_name);
+    ~StateSnapshotPublisher();
+
+    bool is_enabled() const { return shared != nullptr; }
+
+    void set_layer_name(size_t layer, const std::string &name);
+
+    // only writes to shared memory when the snapshot differs from the last one that was published
+    void publish(const state_snapshot::Snapshot &snapshot);
+
+  private:
+    state_snapshot::SharedStateSnapshot *shared = nullptr;
+    state_snapshot::Snapshot last_published_snapshot{};
+    bool published_at_least_once = false;
+};
+
+#endif // STATE_SNAPSHOT_HPP
@@ -0,0 +1,232 @@
+#ifndef STATIC_LAYERS_HPP
+#define STATIC_LAYERS_HPP
+
+#include "input/input_state/input_state.hpp"
+
+#include <array>
+#include <cstddef>
+
+/**
+ * @brief the built-in layers and the combos that activate them, written as constexpr tables so they live in read only
+ * data and mistakes in them are compile errors instead of silently picking whichever mapping comes first.
+ *
+ * A layer is written as
+ *
+ *     inline constexpr auto my_layer = layer(MapName::my_layer, {
+ *         {EKey::a, EKey::ESCAPE},
+ *         ...
+ *     });
+ *
+ * which checks it with validate_layer, so a layer with a mistake in it doesn't compile. ChordSystem uses the tables
+ * directly, the state that changes while typing (whether a mapping is currently active) is kept next to each table in
+ * an array indexed like it.
+ *
+ * NOTE: shift_lock is not in here, it's derived from the shiftable keys of InputState which are only known at runtime
+ */
+namespace static_layers {
+
+enum class MapName {
+    homesick,
+    number_pulldown,
+    programming,
+    shift_lock,
+    vim_arrows,
+    mouse_keys,
+};
+
+// NOTE: mouse_keys has to stay the last map name
+inline constexpr size_t num_map_names = static_cast<size_t>(MapName::mouse_keys) + 1;
+
+struct KeyMapping {
+    EKey input_key;
+    EKey output_key;
+};
+
+template <size_t N> struct StaticLayer {
+    MapName map_name;
+    std::array<KeyMapping, N> key_mappings;
+};
+
+// the same input mapped to the same output more than once
+template <size_t N> constexpr bool has_duplicate_mappings(const StaticLayer<N> &static_layer) {
+    for (size_t i = 0; i < N; i++)
+        for (size_t j = i + 1; j < N; j++)
+            if (static_layer.key_mappings[i].input_key == static_layer.key_mappings[j].input_key and
+                static_layer.key_mappings[i].output_key == static_layer.key_mappings[j].output_key)
+                return true;
+    return false;
+}
+
+// the same input mapped to two different outputs
+template <size_t N> constexpr bool has_conflicting_mappings(const StaticLayer<N> &static_layer) {
+    for (size_t i = 0; i < N; i++)
+        for (size_t j = i + 1; j < N; j++)
+            if (static_layer.key_mappings[i].input_key == static_layer.key_mappings[j].input_key and
+                static_layer.key_mappings[i].output_key != static_layer.key_mappings[j].output_key)
+                return true;
+    return false;
+}
+
+// NOTE: throwing is what turns a failed check into a compile error, the message shows up in it
+template <size_t N> consteval bool validate_layer(const StaticLayer<N> &static_layer) {
+    if (has_duplicate_mappings(static_layer))
+        throw "a layer maps the same key twice";
+    if (has_conflicting_mappings(static_layer))
+        throw "a layer maps a key to two different keys";
+    return true;
+}
+
+template <size_t N> consteval StaticLayer<N> layer(MapName map_name, const KeyMapping (&key_mappings)[N]) {
+    StaticLayer<N> result{map_name, {}};
+    for (size_t i = 0; i < N; i++)
+        result.key_mappings[i] = key_mappings[i];
+    validate_layer(result);
+    return result;
+}
+
+// clang-format off
+inline constexpr auto homesick = layer(MapName::homesick, {
+    {EKey::q, EKey::TAB},
+    {EKey::w, EKey::GRAVE_ACCENT},
+
+    {EKey::a, EKey::ESCAPE},
+
+    {EKey::z, EKey::LEFT_SHIFT},
+    {EKey::x, EKey::LEFT_CONTROL},
+    {EKey::c, EKey::LEFT_SUPER},
+    {EKey::v, EKey::LEFT_ALT},
+
+    {EKey::u, EKey::BACKSPACE},
+    {EKey::i, EKey::LEFT_SQUARE_BRACKET},
+    {EKey::o, EKey::RIGHT_SQUARE_BRACKET},
+    {EKey::p, EKey::BACKSLASH},
+
+    {EKey::l, EKey::SINGLE_QUOTE},
+    {EKey::SEMICOLON, EKey::ENTER},
+
+    // {EKey::n, EKey::FUNCTION_KEY},
+    // {EKey::m, EKey::MENU_KEY},
+    {EKey::COMMA, EKey::RIGHT_ALT},
+    {EKey::PERIOD, EKey::RIGHT_CONTROL},
+    {EKey::SLASH, EKey::RIGHT_SHIFT},
+});
+
+inline constexpr auto number_pulldown = layer(MapName::number_pulldown, {
+    {EKey::a, EKey::ONE},
+    {EKey::s, EKey::TWO},
+    {EKey::d, EKey::THREE},
+    {EKey::f, EKey::FOUR},
+    {EKey::g, EKey::FIVE},
+    {EKey::h, EKey::SIX},
+    {EKey::j, EKey::SEVEN},
+    {EKey::k, EKey::EIGHT},
+    {EKey::l, EKey::NINE},
+    {EKey::SEMICOLON, EKey::ZERO},
+
+    // TODO: there's a problem right now when you try and send something like exclamation point because that's not a
+    // valid key in the context of the virtual keyboard instead we need to do a shift 1 or something of that form,
+    // this also has to be done when the mode is over and we're clearing stuff out.
+
+    {EKey::q, EKey::EXCLAMATION_POINT},
+    {EKey::w, EKey::AT_SIGN},
+    {EKey::e, EKey::NUMBER_SIGN},
+    {EKey::r, EKey::DOLLAR_SIGN},
+    {EKey::t, EKey::PERCENT_SIGN},
+    {EKey::y, EKey::CARET},
+    {EKey::u, EKey::AMPERSAND},
+    {EKey::i, EKey::ASTERISK},
+    {EKey::o, EKey::LEFT_PARENTHESIS},
+    {EKey::p, EKey::RIGHT_PARENTHESIS},
+});
+
+inline constexpr auto programming = layer(MapName::programming, {
+    {EKey::f, EKey::LEFT_PARENTHESIS},  // (
+    {EKey::j, EKey::RIGHT_PARENTHESIS}, // )
+
+    {EKey::d, EKey::LEFT_SQUARE_BRACKET},  // [
+    {EKey::k, EKey::RIGHT_SQUARE_BRACKET}, // ]
+
+    {EKey::s, EKey::LESS_THAN},    // <
+    {EKey::l, EKey::GREATER_THAN}, // >
+
+    {EKey::a, EKey::LEFT_CURLY_BRACKET},          // {
+    {EKey::SEMICOLON, EKey::RIGHT_CURLY_BRACKET}, // }
+
+    {EKey::q, EKey::AMPERSAND},
+    {EKey::w, EKey::UNDERSCORE},
+    {EKey::e, EKey::EQUAL},
+
+    {EKey::u, EKey::PLUS},
+    {EKey::i, EKey::MINUS},
+    {EKey::o, EKey::ASTERISK},
+    {EKey::p, EKey::SLASH},
+
+    {EKey::x, EKey::COLON},
+});
+
+inline constexpr auto vim_arrows = layer(MapName::vim_arrows, {
+    {EKey::h, EKey::LEFT},
+    {EKey::l, EKey::RIGHT},
+    {EKey::j, EKey::DOWN},
+    {EKey::k, EKey::UP},
+});
+
+// NOTE: only the buttons are regular mappings, pointer motion and scrolling are driven by mouse_keys, see
+// ChordSystem::update_mouse_keys
+inline constexpr auto mouse_keys = layer(MapName::mouse_keys, {
+    {EKey::f, EKey::LEFT_MOUSE_BUTTON},
+    {EKey::d, EKey::RIGHT_MOUSE_BUTTON},
+    {EKey::s, EKey::MIDDLE_MOUSE_BUTTON},
+});
+// clang-format on
+
+/**
+ * @brief space + key activates map_name, the position of a combo in this table is its combo index in
+ * SimultaneousKeypresses (and so in the usage statistics)
+ */
+struct MappingCombo {
+    EKey key;
+    MapName map_name;
+};
+
+// clang-format off
+inline constexpr std::array mapping_combos = {
+    MappingCombo{EKey::f, MapName::homesick},
+    MappingCombo{EKey::j, MapName::homesick},
+
+    MappingCombo{EKey::d, MapName::number_pulldown},
+    MappingCombo{EKey::k, MapName::number_pulldown},
+
+    MappingCombo{EKey::s, MapName::programming},
+    MappingCombo{EKey::l, MapName::programming},
+
+    MappingCombo{EKey::v, MapName::vim_arrows},
+
+    MappingCombo{EKey::m, MapName::mouse_keys},
+
+    MappingCombo{EKey::z, MapName::shift_lock},
+    MappingCombo{EKey::SLASH, MapName::shift_lock},
+};
+// clang-format on
+
+template <size_t N> constexpr bool has_conflicting_combos(const std::array<MappingCombo, N> &combos) {
+    for (size_t i = 0; i < N; i++)
+        for (size_t j = i + 1; j < N; j++)
+            if (combos[i].key == combos[j].key)
+                return true;
+    return false;
+}
+
+template <size_t N> constexpr bool uses_space_as_combo_key(const std::array<MappingCombo, N> &combos) {
+    for (const MappingCombo &combo : combos)
+        if (combo.key == EKey::SPACE)
+            return true;
+    return false;
+}
+
+static_assert(not has_conflicting_combos(mapping_combos), "two combos use the same key");
+static_assert(not uses_space_as_combo_key(mapping_combos), "space is already the first key of every combo");
+
+} // namespace static_layers
+
+#endif // STATIC_LAYERS_HPP
@@ -0,0 +1,110 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unistd.h>
+#include <vector>
+
+using namespace trace;
+
+namespace {
+
+struct ThreadBuffer {
+    pid_t thread_id;
+    std::vector<TraceEvent> events;
+    // keeps counting past the end of events, the slot of the next event is num_recorded % events.size()
+    std::atomic<uint64_t> num_recorded = 0;
+};
+
+std::atomic<size_t> buffer_capacity = default_max_events_per_thread;
+
+// NOTE: the buffers are never freed so the events of threads that have exited can still be written out
+std::mutex thread_buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> thread_buffers;
+
+thread_local ThreadBuffer *this_thread_buffer = nullptr;
+
+ThreadBuffer &get_this_thread_buffer() {
+    if (this_thread_buffer == nullptr) {
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->thread_id = gettid();
+        buffer->events.resize(buffer_capacity.load(std::memory_order_relaxed));
+
+        std::lock_guard lock(thread_buffers_mutex);
+        this_thread_buffer = buffer.get();
+        thread_buffers.push_back(std::move(buffer));
+    }
+    return *this_thread_buffer;
+}
+
+} // namespace
+
+void trace::enable(size_t max_events_per_thread) {
+    buffer_capacity.store(std::max<size_t>(max_events_per_thread, 1), std::memory_order_relaxed);
+    // allocates now so that the first traced tick isn't the one paying for it
+    get_this_thread_buffer();
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+void trace::disable() { enabled.store(false, std::memory_order_relaxed); }
+
+void trace::record(const char *name, Phase phase, uint64_t timestamp_ns, uint64_t duration_ns, uint64_t id) {
+    ThreadBuffer &buffer = get_this_thread_buffer();
+    uint64_t num_recorded = buffer.num_recorded.load(std::memory_order_relaxed);
+    buffer.events[num_recorded % buffer.events.size()] = {name, phase, timestamp_ns, duration_ns, id};
+    buffer.num_recorded.store(num_recorded + 1, std::memory_order_release);
+}
+
+bool trace::write_chrome_trace(const std::string &path) {
+    std::ofstream file(path);
+    if (not file) {
+        std::cerr << "couldn't open " << path << " to write the trace\n";
+        return false;
+    }
+
+    pid_t process_id = getpid();
+    // chrome traces are in microseconds, the fraction keeps the nanoseconds
+    auto to_us = [](uint64_t ns) { return ns / 1000.0; };
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    bool first_event = true;
+    std::lock_guard lock(thread_buffers_mutex);
+    for (const auto &buffer : thread_buffers) {
+        uint64_t num_recorded = buffer->num_recorded.load(std::memory_order_acquire);
+        size_t capacity = buffer->events.size();
+        // once the buffer has wrapped around the oldest event is the one that will be overwritten next
+        uint64_t first = num_recorded > capacity ? num_recorded - capacity : 0;
+
+        for (uint64_t i = first; i < num_recorded; i++) {
+            const TraceEvent &event = buffer->events[i % capacity];
+            file << (first_event ? "\n" : ",\n");
+            first_event = false;
+
+            file << "{\"name\":\"" << event.name << "\",\"ph\":\"" << static_cast<char>(event.phase)
+                 << "\",\"ts\":" << to_us(event.timestamp_ns) << ",\"pid\":" << process_id
+                 << ",\"tid\":" << buffer->thread_id;
+            switch (event.phase) {
+            case Phase::complete:
+                file << ",\"dur\":" << to_us(event.duration_ns);
+                break;
+            case Phase::flow_start:
+                file << ",\"cat\":\"key\",\"id\":" << event.id;
+                break;
+            case Phase::flow_end:
+                // binds to the enclosing slice (the write) instead of the next one
+                file << ",\"cat\":\"key\",\"id\":" << event.id << ",\"bp\":\"e\"";
+                break;
+            }
+            file << "}";
+        }
+    }
+
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
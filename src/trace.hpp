@@ -0,0 +1,99 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief records where the time of each tick goes so it can be opened in chrome://tracing or ui.perfetto.dev.
+ *
+ * TraceScope marks a stage of the pipeline (the same ones GlobalLogSection marks for the text logs), and every key
+ * event gets an id when it's read which is connected with a flow arrow to the write that sent the result to the virtual
+ * keyboard, so a slow keystroke can be followed from one end to the other.
+ *
+ * Every thread records into its own buffer that is allocated once, when the thread records its first event, so
+ * recording is a clock read and a store. When a buffer is full the oldest events are overwritten. While tracing is off
+ * a scope costs one relaxed load.
+ *
+ * NOTE: write_chrome_trace reads the buffers of every thread, so call it from the thread that records (eg between
+ * ticks) or after the other threads have stopped
+ */
+namespace trace {
+
+inline constexpr size_t default_max_events_per_thread = 1 << 20;
+
+// the phase of a chrome trace event
+enum class Phase : char {
+    complete = 'X',
+    flow_start = 's',
+    flow_end = 'f',
+};
+
+struct TraceEvent {
+    const char *name;
+    Phase phase;
+    uint64_t timestamp_ns;
+    uint64_t duration_ns;
+    // connects a flow start with its flow end
+    uint64_t id;
+};
+
+inline std::atomic<bool> enabled = false;
+
+inline bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+
+// buffers that are already allocated keep their size
+void enable(size_t max_events_per_thread = default_max_events_per_thread);
+void disable();
+
+// names must be string literals (or otherwise outlive the trace), only the pointer is stored
+void record(const char *name, Phase phase, uint64_t timestamp_ns, uint64_t duration_ns = 0, uint64_t id = 0);
+
+inline uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// key events read and written, ids are handed out by the caller
+inline void record_key_event_read(uint64_t id) {
+    if (is_enabled())
+        record("key", Phase::flow_start, now_ns(), 0, id);
+}
+inline void record_key_event_written(uint64_t id) {
+    if (is_enabled())
+        record("key", Phase::flow_end, now_ns(), 0, id);
+}
+
+// writes every thread's events as chrome trace json (which perfetto also opens), returns false on failure
+bool write_chrome_trace(const std::string &path);
+
+} // namespace trace
+
+/**
+ * @brief records how long the enclosing scope took, used like GlobalLogSection:
+ *
+ *     TraceScope _("update");
+ */
+class TraceScope {
+  public:
+    explicit TraceScope(const char *name) : name(name), start_ns(trace::is_enabled() ? trace::now_ns() : 0) {}
+
+    ~TraceScope() {
+        // NOTE: a scope that began before tracing was turned on has no start time and isn't recorded
+        if (start_ns != 0 and trace::is_enabled())
+            trace::record(name, trace::Phase::complete, start_ns, trace::now_ns() - start_ns);
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+  private:
+    const char *name;
+    uint64_t start_ns;
+};
+
+#endif // TRACE_HPP
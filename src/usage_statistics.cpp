@@ -0,0 +1,145 @@
+#include "usage_statistics.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace usage_statistics;
+
+UsageStatistics::UsageStatistics(const std::string &shared_memory_name) {
+    // NOTE: the counters say which keys you type, so no one but the user running key_interceptor may read them. A
+    // segment left by an older run is only reused if that user owns it, one owned by anyone else may still be mapped
+    // by them and changing its mode wouldn't take that away, so it's replaced. The new one is created with no
+    // permissions for anyone else from the start, and if someone creates it again in between, O_EXCL fails.
+    struct stat file_status;
+    int fd = shm_open(shared_memory_name.c_str(), O_RDWR, 0);
+    if (fd >= 0 and (fstat(fd, &file_status) < 0 or file_status.st_uid != geteuid())) {
+        close(fd);
+        fd = -1;
+        shm_unlink(shared_memory_name.c_str());
+    }
+    if (fd < 0) {
+        mode_t previous_umask = umask(0077);
+        fd = shm_open(shared_memory_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        umask(previous_umask);
+        if (fd < 0) {
+            perror("shm_open usage statistics");
+            return;
+        }
+    } else if (fchmod(fd, 0600) < 0) {
+        perror("fchmod usage statistics");
+    }
+
+    bool already_initialized = fstat(fd, &file_status) == 0 and file_status.st_size == sizeof(SharedUsageStatistics);
+
+    if (not already_initialized and ftruncate(fd, sizeof(SharedUsageStatistics)) < 0) {
+        perror("ftruncate usage statistics");
+        close(fd);
+        return;
+    }
+
+    void *address = mmap(nullptr, sizeof(SharedUsageStatistics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        perror("mmap usage statistics");
+        return;
+    }
+
+    shared = static_cast<SharedUsageStatistics *>(address);
+
+    // NOTE: counters from previous runs are kept as long as the layout hasn't changed
+    if (not already_initialized or shared->magic != magic or shared->version != version) {
+        memset(address, 0, sizeof(SharedUsageStatistics));
+        shared = new (address) SharedUsageStatistics();
+        shared->magic = magic;
+        shared->version = version;
+    }
+}
+
+UsageStatistics::~UsageStatistics() {
+    if (shared != nullptr)
+        munmap(shared, sizeof(SharedUsageStatistics));
+}
+
+void UsageStatistics::set_layer_name(size_t layer, const std::string &name) {
+    if (shared == nullptr or layer >= max_layers)
+        return;
+
+    strncpy(shared->layer_names[layer], name.c_str(), max_name_length - 1);
+    if (layer + 1 > shared->num_layers)
+        shared->num_layers = layer + 1;
+}
+
+void UsageStatistics::set_key_name(int linux_code, const std::string &name) {
+    if (shared == nullptr or linux_code < 0 or linux_code >= KEY_CNT)
+        return;
+
+    strncpy(shared->key_names[linux_code], name.c_str(), max_name_length - 1);
+}
+
+void UsageStatistics::set_combo(size_t combo_index, int key1_linux_code, int key2_linux_code, int layer) {
+    if (shared == nullptr or combo_index >= max_combos)
+        return;
+
+    ComboStatistics &combo = shared->combos[combo_index];
+    combo.key1_linux_code = key1_linux_code;
+    combo.key2_linux_code = key2_linux_code;
+    combo.layer = layer;
+    if (combo_index + 1 > shared->num_combos)
+        shared->num_combos = combo_index + 1;
+}
+
+void UsageStatistics::set_combo_threshold(std::chrono::milliseconds threshold) {
+    combo_threshold = threshold;
+    if (shared != nullptr)
+        shared->combo_threshold_ms = threshold.count();
+}
+
+void UsageStatistics::record_tick() {
+    if (shared != nullptr)
+        shared->num_ticks.increment();
+}
+
+void UsageStatistics::record_layer_activation(size_t layer) {
+    if (shared == nullptr or layer >= max_layers)
+        return;
+
+    shared->layer_activations[layer].increment();
+}
+
+void UsageStatistics::record_remapped_key_press(size_t layer, int linux_code) {
+    if (shared == nullptr or layer >= max_layers or linux_code < 0 or linux_code >= KEY_CNT)
+        return;
+
+    shared->layer_remapped_key_presses[layer].increment();
+    shared->remapped_key_presses[linux_code].increment();
+}
+
+void UsageStatistics::record_combo_attempt(size_t combo_index, std::chrono::milliseconds gap, bool fired) {
+    if (shared == nullptr or combo_index >= max_combos)
+        return;
+
+    ComboStatistics &combo = shared->combos[combo_index];
+
+    size_t bucket = gap.count() < 0 ? 0 : static_cast<size_t>(gap.count());
+    if (bucket >= num_gap_histogram_buckets)
+        bucket = num_gap_histogram_buckets - 1;
+    combo.gap_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    if (fired) {
+        combo.num_fired.increment();
+    } else if (gap < 2 * combo_threshold) {
+        combo.num_near_misses.increment();
+    }
+}
+
+void UsageStatistics::record_suppressed_bounce(int linux_code) {
+    if (shared == nullptr or linux_code < 0 or linux_code >= KEY_CNT)
+        return;
+
+    shared->suppressed_bounces[linux_code].increment();
+}
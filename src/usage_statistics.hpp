@@ -0,0 +1,101 @@
+#ifndef USAGE_STATISTICS_HPP
+#define USAGE_STATISTICS_HPP
+
+#include <linux/input-event-codes.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief the layout of the usage statistics file that lives in /dev/shm, it is shared with the key_interceptor_stats
+ * tool which maps the same file read only, so this header must stay free of anything but plain data.
+ *
+ * Every counter sits on its own cache line so the reader never causes false sharing with the input thread, and all
+ * updates are relaxed atomic increments which is all the hot path pays for. Counters accumulate across runs until the
+ * file is deleted.
+ */
+namespace usage_statistics {
+
+inline constexpr const char *default_shared_memory_name = "/key_interceptor_stats";
+inline constexpr uint32_t magic = 0x4b495354; // "KIST"
+inline constexpr uint32_t version = 2;
+
+inline constexpr size_t max_layers = 16;
+inline constexpr size_t max_combos = 64;
+inline constexpr size_t max_name_length = 32;
+// one bucket per millisecond of gap between the two keys of a combo, the last bucket holds everything longer
+inline constexpr size_t num_gap_histogram_buckets = 128;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "counters must be usable from shared memory");
+
+struct alignas(64) PaddedCounter {
+    std::atomic<uint64_t> value;
+
+    void increment() { value.fetch_add(1, std::memory_order_relaxed); }
+    uint64_t load() const { return value.load(std::memory_order_relaxed); }
+};
+
+struct alignas(64) ComboStatistics {
+    int32_t key1_linux_code;
+    int32_t key2_linux_code;
+    int32_t layer;
+    PaddedCounter num_fired;
+    // both keys were pressed but the gap between them was above the threshold by less than the threshold itself, most
+    // likely an intended combo that was too slow
+    PaddedCounter num_near_misses;
+    std::atomic<uint64_t> gap_histogram[num_gap_histogram_buckets];
+};
+
+struct SharedUsageStatistics {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_layers;
+    uint32_t num_combos;
+    uint32_t combo_threshold_ms;
+
+    char layer_names[max_layers][max_name_length];
+    char key_names[KEY_CNT][max_name_length];
+
+    PaddedCounter num_ticks;
+    PaddedCounter layer_activations[max_layers];
+    // presses of keys that a layer remapped, per layer and per source key
+    PaddedCounter layer_remapped_key_presses[max_layers];
+    PaddedCounter remapped_key_presses[KEY_CNT];
+    ComboStatistics combos[max_combos];
+    // edges of a chattering key that the debounce swallowed, see EagerDebounce
+    PaddedCounter suppressed_bounces[KEY_CNT];
+};
+
+} // namespace usage_statistics
+
+/**
+ * @brief the writing side of the usage statistics, if the file can't be mapped every record call is a no-op
+ */
+class UsageStatistics {
+  public:
+    UsageStatistics(const std::string &shared_memory_name = usage_statistics::default_shared_memory_name);
+    ~UsageStatistics();
+
+    bool is_enabled() const { return shared != nullptr; }
+
+    // descriptive data, written at startup before anything is recorded
+    void set_layer_name(size_t layer, const std::string &name);
+    void set_key_name(int linux_code, const std::string &name);
+    void set_combo(size_t combo_index, int key1_linux_code, int key2_linux_code, int layer);
+    void set_combo_threshold(std::chrono::milliseconds threshold);
+
+    void record_tick();
+    void record_layer_activation(size_t layer);
+    void record_remapped_key_press(size_t layer, int linux_code);
+    void record_combo_attempt(size_t combo_index, std::chrono::milliseconds gap, bool fired);
+    void record_suppressed_bounce(int linux_code);
+
+  private:
+    usage_statistics::SharedUsageStatistics *shared = nullptr;
+    std::chrono::milliseconds combo_threshold{0};
+};
+
+#endif // USAGE_STATISTICS_HPP
@@ -0,0 +1,112 @@
+#include "input_source.hpp"
+#include "key_interceptor.hpp"
+#include "output_sink.hpp"
+#include "stall_watchdog.hpp"
+
+#include "utility/logger/logger.hpp"
+
+#include <bitset>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief runs a key interceptor on an in memory source and sink under a stall watchdog, lets the loop stall while a key
+ * is held and checks the sequence KeyInterceptor::check_in_with_stall_watchdog goes through: the update that notices
+ * the watchdog fired throws away what was typed in the meantime (it already reached the os), releases what was held
+ * through the sink, and the loop carries on forwarding as before.
+ *
+ * Needs no devices, exits with 1 if any check failed, eg: ./key_interceptor_stall_watchdog_test
+ */
+
+constexpr std::chrono::milliseconds deadline{20};
+
+struct OutputRecorder {
+    InMemoryOutputSink &output_sink;
+    std::bitset<KEY_CNT> pressed;
+    std::vector<int> pressed_codes;
+    std::vector<int> released_codes;
+
+    explicit OutputRecorder(InMemoryOutputSink &output_sink) : output_sink(output_sink) {}
+
+    // what was flushed since the last call
+    void drain() {
+        pressed_codes.clear();
+        released_codes.clear();
+        for (const struct input_event &ev : output_sink.take_events()) {
+            if (ev.type != EV_KEY or ev.value == LinuxInputAdapter::repeat_value)
+                continue;
+
+            bool is_pressed = ev.value == LinuxInputAdapter::press_value;
+            pressed.set(ev.code, is_pressed);
+            (is_pressed ? pressed_codes : released_codes).push_back(ev.code);
+        }
+    }
+};
+
+struct input_event make_event(int type, int code, int value) {
+    struct input_event ev = {};
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    return ev;
+}
+
+std::vector<struct input_event> make_key_frame(int linux_code, int value) {
+    return {make_event(EV_KEY, linux_code, value), make_event(EV_SYN, SYN_REPORT, 0)};
+}
+
+int num_failed_checks = 0;
+
+void check(bool condition, const std::string &description) {
+    std::cout << (condition ? "ok     " : "FAILED ") << description << "\n";
+    if (not condition)
+        num_failed_checks++;
+}
+
+int main() {
+    global_logger->remove_all_sinks();
+
+    auto input_source_ptr = std::make_unique<InMemoryInputSource>();
+    auto output_sink_ptr = std::make_unique<InMemoryOutputSink>();
+    InMemoryInputSource &input_source = *input_source_ptr;
+    OutputRecorder output_recorder(*output_sink_ptr);
+
+    KeyInterceptor key_interceptor([]() {}, std::move(input_source_ptr), std::move(output_sink_ptr));
+    StallWatchdog stall_watchdog(-1, -1, deadline);
+    key_interceptor.set_stall_watchdog(&stall_watchdog);
+
+    input_source.push(make_key_frame(KEY_A, LinuxInputAdapter::press_value));
+    key_interceptor.update();
+    output_recorder.drain();
+    check(output_recorder.pressed.test(KEY_A), "a held key is forwarded while the loop keeps up");
+    check(stall_watchdog.get_held_keys().test(KEY_A), "the watchdog knows the held key");
+
+    // NOTE: the watchdog checks four times per deadline, a few deadlines without a beat are sure to be noticed
+    std::this_thread::sleep_for(deadline * 5);
+    check(stall_watchdog.get_num_stalls() == 1, "a loop that doesn't update for longer than the deadline stalls");
+
+    // typed while the keyboard belonged to the os
+    input_source.push(make_key_frame(KEY_B, LinuxInputAdapter::press_value));
+    input_source.push(make_key_frame(KEY_B, LinuxInputAdapter::release_value));
+    key_interceptor.update();
+    output_recorder.drain();
+    check(output_recorder.pressed_codes.empty(), "what was typed during the stall isn't forwarded again");
+    check(not output_recorder.pressed.test(KEY_A), "the key held when the loop stalled is released through the sink");
+    check(not key_interceptor.virtual_keys.any(), "no key is down on the virtual keyboard after recovering");
+    check(not key_interceptor.linux_input_adapter.key_bitmap_state.current.any(), "the key state is resynced");
+
+    input_source.push(make_key_frame(KEY_C, LinuxInputAdapter::press_value));
+    key_interceptor.update();
+    input_source.push(make_key_frame(KEY_C, LinuxInputAdapter::release_value));
+    key_interceptor.update();
+    output_recorder.drain();
+    check(output_recorder.pressed_codes == std::vector<int>{KEY_C}, "keys are forwarded again after recovering");
+    check(not output_recorder.pressed.any(), "nothing is left held");
+    check(stall_watchdog.get_num_stalls() == 1, "the watchdog went back to watching without firing again");
+
+    return num_failed_checks == 0 ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+#include "injection_socket.hpp"
+
+#include <linux/input-event-codes.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace injection;
+
+/**
+ * @brief types through a running key_interceptor started with --injection-socket, either a single frame of taps or a
+ * stream of frames to measure how many injected events it keeps up with, eg:
+ *
+ *     key_interceptor_inject tap 35 18 38 38 24      (h e l l o)
+ *     key_interceptor_inject throughput --rate=1000 --batch=8 --duration=5
+ *
+ * Run the interceptor with --measure-latency while measuring throughput to see whether the injected events slow down
+ * the keys you type yourself.
+ */
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<unsigned char> make_frame(const std::vector<KeyEvent> &events) {
+    FrameHeader header = {magic, version, static_cast<uint16_t>(events.size())};
+    std::vector<unsigned char> frame(get_frame_size(events.size()));
+    memcpy(frame.data(), &header, sizeof(header));
+    memcpy(frame.data() + sizeof(header), events.data(), events.size() * sizeof(KeyEvent));
+    return frame;
+}
+
+int connect_to_injection_socket(const std::string &socket_path) {
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "socket path is too long: " << socket_path << "\n";
+        return -1;
+    }
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    int file_descriptor = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (file_descriptor < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    if (connect(file_descriptor, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) < 0) {
+        perror(("connect " + socket_path + ", is key_interceptor running with --injection-socket?").c_str());
+        close(file_descriptor);
+        return -1;
+    }
+    return file_descriptor;
+}
+
+int tap(int file_descriptor, const std::vector<int> &linux_codes) {
+    std::vector<KeyEvent> events;
+    for (int linux_code : linux_codes) {
+        events.push_back({static_cast<uint16_t>(linux_code), 1, 0});
+        events.push_back({static_cast<uint16_t>(linux_code), 0, 0});
+    }
+
+    if (events.empty() or events.size() > max_events_per_frame) {
+        std::cerr << "between 1 and " << max_events_per_frame / 2 << " keys fit in a frame\n";
+        return 1;
+    }
+
+    std::vector<unsigned char> frame = make_frame(events);
+    if (send(file_descriptor, frame.data(), frame.size(), 0) < 0) {
+        perror("send");
+        return 1;
+    }
+    return 0;
+}
+
+struct ThroughputSettings {
+    // 0 sends as fast as the interceptor takes them
+    double frames_per_second = 1000;
+    double duration_seconds = 5;
+    size_t events_per_frame = 8;
+    // F24 doesn't do anything on most desktops
+    int linux_code = KEY_F24;
+};
+
+int measure_throughput(int file_descriptor, const ThroughputSettings &settings) {
+    if (settings.events_per_frame == 0 or settings.events_per_frame > max_events_per_frame) {
+        std::cerr << "a frame holds between 1 and " << max_events_per_frame << " events\n";
+        return 1;
+    }
+
+    // presses and releases alternate so the key is never left down
+    std::vector<KeyEvent> events;
+    for (size_t i = 0; i < settings.events_per_frame; i++)
+        events.push_back({static_cast<uint16_t>(settings.linux_code), static_cast<uint8_t>(i % 2 == 0), 0});
+    if (settings.events_per_frame % 2 == 1)
+        events.push_back({static_cast<uint16_t>(settings.linux_code), 0, 0});
+    std::vector<unsigned char> frame = make_frame(events);
+
+    auto frame_interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(settings.frames_per_second > 0 ? 1.0 / settings.frames_per_second : 0));
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(
+                                        std::chrono::duration<double>(settings.duration_seconds));
+
+    size_t num_frames_sent = 0;
+    Clock::time_point next_frame = start;
+    while (Clock::now() < end) {
+        // NOTE: a blocking send waits whenever the interceptor's receive queue is full, so this is also the rate it
+        // keeps up with
+        if (send(file_descriptor, frame.data(), frame.size(), 0) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("send");
+            return 1;
+        }
+        num_frames_sent++;
+
+        if (settings.frames_per_second > 0) {
+            next_frame += frame_interval;
+            std::this_thread::sleep_until(next_frame);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "sent " << num_frames_sent << " frames of " << events.size() << " events in " << seconds << "s, "
+              << num_frames_sent / seconds << " frames/s, " << num_frames_sent * events.size() / seconds
+              << " events/s\n";
+    return 0;
+}
+
+void print_usage() {
+    std::cerr << "usage: key_interceptor_inject [--socket=path] tap linux_code...\n"
+                 "       key_interceptor_inject [--socket=path] throughput [--rate=frames_per_second] "
+                 "[--duration=seconds] [--batch=events_per_frame] [--key=linux_code]\n";
+}
+
+int main(int argc, char *argv[]) {
+    std::string socket_path = default_socket_path;
+    int i = 1;
+    if (i < argc and std::string(argv[i]).starts_with("--socket=")) {
+        socket_path = std::string(argv[i]).substr(std::string("--socket=").size());
+        i++;
+    }
+
+    if (i >= argc) {
+        print_usage();
+        return 1;
+    }
+    std::string command = argv[i++];
+
+    if (command == "tap") {
+        std::vector<int> linux_codes;
+        for (; i < argc; i++)
+            linux_codes.push_back(std::stoi(argv[i]));
+
+        int file_descriptor = connect_to_injection_socket(socket_path);
+        if (file_descriptor < 0)
+            return 1;
+        int result = tap(file_descriptor, linux_codes);
+        close(file_descriptor);
+        return result;
+    }
+
+    if (command == "throughput") {
+        ThroughputSettings settings;
+        for (; i < argc; i++) {
+            std::string arg = argv[i];
+            auto value_of = [&](const std::string &prefix) { return arg.substr(prefix.size()); };
+            if (arg.starts_with("--rate=")) {
+                settings.frames_per_second = std::stod(value_of("--rate="));
+            } else if (arg.starts_with("--duration=")) {
+                settings.duration_seconds = std::stod(value_of("--duration="));
+            } else if (arg.starts_with("--batch=")) {
+                settings.events_per_frame = std::stoul(value_of("--batch="));
+            } else if (arg.starts_with("--key=")) {
+                settings.linux_code = std::stoi(value_of("--key="));
+            } else {
+                print_usage();
+                return 1;
+            }
+        }
+
+        int file_descriptor = connect_to_injection_socket(socket_path);
+        if (file_descriptor < 0)
+            return 1;
+        int result = measure_throughput(file_descriptor, settings);
+        close(file_descriptor);
+        return result;
+    }
+
+    print_usage();
+    return 1;
+}
@@ -0,0 +1,137 @@
+#include "usage_statistics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace usage_statistics;
+
+std::string get_key_name(const SharedUsageStatistics &statistics, int linux_code) {
+    if (linux_code < 0 or linux_code >= KEY_CNT or statistics.key_names[linux_code][0] == '\0')
+        return "code " + std::to_string(linux_code);
+    return std::string(statistics.key_names[linux_code], strnlen(statistics.key_names[linux_code], max_name_length));
+}
+
+std::string get_layer_name(const SharedUsageStatistics &statistics, int layer) {
+    if (layer < 0 or layer >= static_cast<int>(max_layers))
+        return "unknown";
+    return std::string(statistics.layer_names[layer], strnlen(statistics.layer_names[layer], max_name_length));
+}
+
+// the gap below which the given fraction of the combo's attempts fell
+int get_gap_percentile(const ComboStatistics &combo, double fraction) {
+    uint64_t total = 0;
+    for (const auto &bucket : combo.gap_histogram)
+        total += bucket.load(std::memory_order_relaxed);
+    if (total == 0)
+        return -1;
+
+    uint64_t running_total = 0;
+    for (size_t i = 0; i < num_gap_histogram_buckets; i++) {
+        running_total += combo.gap_histogram[i].load(std::memory_order_relaxed);
+        if (running_total >= fraction * total)
+            return i;
+    }
+    return num_gap_histogram_buckets - 1;
+}
+
+// the keys whose counter isn't zero, most counted first
+void print_key_counters(const SharedUsageStatistics &statistics, const std::string &title,
+                        const PaddedCounter (&counters)[KEY_CNT]) {
+    std::vector<std::pair<uint64_t, int>> keys;
+    for (int linux_code = 0; linux_code < KEY_CNT; linux_code++) {
+        uint64_t count = counters[linux_code].load();
+        if (count > 0)
+            keys.emplace_back(count, linux_code);
+    }
+    std::sort(keys.rbegin(), keys.rend());
+
+    std::cout << "\n" << title << "\n";
+    for (const auto &[count, linux_code] : keys)
+        std::cout << std::left << std::setw(20) << get_key_name(statistics, linux_code) << std::right << std::setw(12)
+                  << count << "\n";
+}
+
+void print_statistics(const SharedUsageStatistics &statistics) {
+    std::cout << "ticks: " << statistics.num_ticks.load() << "\n\n";
+
+    std::cout << std::left << std::setw(20) << "layer" << std::right << std::setw(14) << "activations"
+              << std::setw(18) << "remapped presses" << "\n";
+    for (size_t layer = 0; layer < std::min<size_t>(statistics.num_layers, max_layers); layer++) {
+        std::cout << std::left << std::setw(20) << get_layer_name(statistics, layer) << std::right << std::setw(14)
+                  << statistics.layer_activations[layer].load() << std::setw(18)
+                  << statistics.layer_remapped_key_presses[layer].load() << "\n";
+    }
+
+    std::cout << "\ncombos (threshold " << statistics.combo_threshold_ms << "ms, near miss = slower than the "
+              << "threshold by less than the threshold)\n";
+    std::cout << std::left << std::setw(24) << "combo" << std::setw(20) << "layer" << std::right << std::setw(8)
+              << "fired" << std::setw(12) << "near miss" << std::setw(12) << "gap p50" << std::setw(12) << "gap p90"
+              << "\n";
+    for (size_t i = 0; i < std::min<size_t>(statistics.num_combos, max_combos); i++) {
+        const ComboStatistics &combo = statistics.combos[i];
+        std::string name =
+            get_key_name(statistics, combo.key1_linux_code) + " + " + get_key_name(statistics, combo.key2_linux_code);
+        std::cout << std::left << std::setw(24) << name << std::setw(20) << get_layer_name(statistics, combo.layer)
+                  << std::right << std::setw(8) << combo.num_fired.load() << std::setw(12)
+                  << combo.num_near_misses.load() << std::setw(10) << get_gap_percentile(combo, 0.5) << "ms"
+                  << std::setw(10) << get_gap_percentile(combo, 0.9) << "ms\n";
+    }
+
+    print_key_counters(statistics, "remapped keys", statistics.remapped_key_presses);
+    print_key_counters(statistics, "suppressed bounces (only counted with --debounce-ms)",
+                       statistics.suppressed_bounces);
+}
+
+// prints the usage statistics that a running (or previously run) key_interceptor keeps in shared memory, the file is
+// mapped read only so this never touches the interceptor itself. Pass --watch to refresh every second.
+int main(int argc, char *argv[]) {
+    bool watch = argc > 1 and std::string(argv[1]) == "--watch";
+
+    int fd = shm_open(default_shared_memory_name, O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "no usage statistics found, has key_interceptor been run?\n";
+        return 1;
+    }
+
+    struct stat file_status;
+    if (fstat(fd, &file_status) < 0 or file_status.st_size != sizeof(SharedUsageStatistics)) {
+        std::cerr << "usage statistics were written by an incompatible version of key_interceptor\n";
+        close(fd);
+        return 1;
+    }
+
+    void *address = mmap(nullptr, sizeof(SharedUsageStatistics), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        perror("mmap usage statistics");
+        return 1;
+    }
+
+    const auto &statistics = *static_cast<const SharedUsageStatistics *>(address);
+    if (statistics.magic != magic or statistics.version != version) {
+        std::cerr << "usage statistics were written by an incompatible version of key_interceptor\n";
+        return 1;
+    }
+
+    do {
+        if (watch)
+            std::cout << "\033[2J\033[H";
+        print_statistics(statistics);
+        std::cout.flush();
+        if (watch)
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+    } while (watch);
+
+    munmap(address, sizeof(SharedUsageStatistics));
+}
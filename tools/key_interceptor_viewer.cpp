@@ -0,0 +1,149 @@
+#include "state_snapshot.hpp"
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace state_snapshot;
+
+struct KeyboardKey {
+    std::string label;
+    int linux_code;
+    // some keys are forwarded under a different code, eg enter goes out as KEY_KPENTER
+    int alternative_linux_code = -1;
+};
+
+const std::vector<std::vector<KeyboardKey>> keyboard_rows = {
+    {{"esc", KEY_ESC},  {"f1", KEY_F1},   {"f2", KEY_F2},   {"f3", KEY_F3},   {"f4", KEY_F4},
+     {"f5", KEY_F5},    {"f6", KEY_F6},   {"f7", KEY_F7},   {"f8", KEY_F8},   {"f9", KEY_F9},
+     {"f10", KEY_F10},  {"f11", KEY_F11}, {"f12", KEY_F12}},
+    {{"`", KEY_GRAVE}, {"1", KEY_1},     {"2", KEY_2},     {"3", KEY_3},     {"4", KEY_4},
+     {"5", KEY_5},     {"6", KEY_6},     {"7", KEY_7},     {"8", KEY_8},     {"9", KEY_9},
+     {"0", KEY_0},     {"-", KEY_MINUS}, {"=", KEY_EQUAL}, {"backspace", KEY_BACKSPACE}},
+    {{"tab", KEY_TAB}, {"q", KEY_Q},         {"w", KEY_W},          {"e", KEY_E},        {"r", KEY_R},
+     {"t", KEY_T},     {"y", KEY_Y},         {"u", KEY_U},          {"i", KEY_I},        {"o", KEY_O},
+     {"p", KEY_P},     {"[", KEY_LEFTBRACE}, {"]", KEY_RIGHTBRACE}, {"\\", KEY_BACKSLASH}},
+    {{"caps", KEY_CAPSLOCK}, {"a", KEY_A}, {"s", KEY_S},         {"d", KEY_D},          {"f", KEY_F},
+     {"g", KEY_G},           {"h", KEY_H}, {"j", KEY_J},         {"k", KEY_K},          {"l", KEY_L},
+     {";", KEY_SEMICOLON},   {"'", KEY_APOSTROPHE},              {"enter", KEY_ENTER, KEY_KPENTER}},
+    {{"lshift", KEY_LEFTSHIFT}, {"z", KEY_Z}, {"x", KEY_X},     {"c", KEY_C},     {"v", KEY_V},
+     {"b", KEY_B},              {"n", KEY_N}, {"m", KEY_M},     {",", KEY_COMMA}, {".", KEY_DOT},
+     {"/", KEY_SLASH},          {"rshift", KEY_RIGHTSHIFT}},
+    {{"lctrl", KEY_LEFTCTRL}, {"super", KEY_LEFTMETA}, {"lalt", KEY_LEFTALT}, {"        space        ", KEY_SPACE},
+     {"ralt", KEY_RIGHTALT},  {"menu", KEY_MENU},      {"rctrl", KEY_RIGHTCTRL}},
+    {{"left", KEY_LEFT}, {"down", KEY_DOWN}, {"up", KEY_UP}, {"right", KEY_RIGHT}, {"lmb", BTN_LEFT},
+     {"mmb", BTN_MIDDLE}, {"rmb", BTN_RIGHT}},
+};
+
+std::string render_keyboard(const uint64_t (&keys)[num_key_bitmap_words]) {
+    std::ostringstream out;
+    for (const auto &row : keyboard_rows) {
+        for (const KeyboardKey &key : row) {
+            bool pressed = Snapshot::is_key_set(keys, key.linux_code) or
+                           (key.alternative_linux_code >= 0 and Snapshot::is_key_set(keys, key.alternative_linux_code));
+            if (pressed)
+                out << "\033[7m";
+            out << "[" << key.label << "]";
+            if (pressed)
+                out << "\033[0m";
+            out << " ";
+        }
+        out << "\033[K\n";
+    }
+    return out.str();
+}
+
+std::string get_layer_name(const SharedStateSnapshot &shared, int layer) {
+    if (layer < 0 or layer >= static_cast<int>(max_layers))
+        return "unknown";
+    return std::string(shared.layer_names[layer], strnlen(shared.layer_names[layer], max_layer_name_length));
+}
+
+void render(const SharedStateSnapshot &shared, const Snapshot &snapshot) {
+    std::ostringstream out;
+    out << "\033[H";
+
+    if (snapshot.mode_flags & mapping_mode_active) {
+        out << "mapping:";
+        for (uint32_t i = 0; i < snapshot.layer_stack_depth and i < max_layer_stack_depth; i++)
+            out << " " << get_layer_name(shared, snapshot.layer_stack[i]);
+    } else {
+        out << "not mapping";
+    }
+    out << "    last combo gap: " << snapshot.last_combo_gap_ms << "ms\033[K\n\n";
+
+    out << "physical keyboard\033[K\n" << render_keyboard(snapshot.physical_keys) << "\033[K\n";
+    out << "virtual keyboard\033[K\n" << render_keyboard(snapshot.virtual_keys);
+
+    std::cout << out.str();
+    std::cout.flush();
+}
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+// renders the state published by a key_interceptor running with --publish-state in the terminal, at its own pace and in
+// its own process, so the interceptor can run with --headless
+int main(int argc, char *argv[]) {
+    double frames_per_second = 60;
+    if (argc > 1)
+        frames_per_second = std::stod(argv[1]);
+
+    int fd = shm_open(default_shared_memory_name, O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "no state snapshot found, is key_interceptor running with --publish-state and as this user?\n";
+        return 1;
+    }
+
+    struct stat file_status;
+    if (fstat(fd, &file_status) < 0 or file_status.st_size != sizeof(SharedStateSnapshot)) {
+        std::cerr << "the state snapshot was written by an incompatible version of key_interceptor\n";
+        close(fd);
+        return 1;
+    }
+
+    void *address = mmap(nullptr, sizeof(SharedStateSnapshot), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        perror("mmap state snapshot");
+        return 1;
+    }
+
+    const auto &shared = *static_cast<const SharedStateSnapshot *>(address);
+    if (shared.magic != magic or shared.version != version) {
+        std::cerr << "the state snapshot was written by an incompatible version of key_interceptor\n";
+        return 1;
+    }
+
+    std::signal(SIGINT, [](int) { stop_requested = 1; });
+    std::signal(SIGTERM, [](int) { stop_requested = 1; });
+
+    std::cout << "\033[2J\033[?25l";
+
+    uint64_t last_rendered_sequence = 1; // odd so the first frame is always drawn
+    auto frame_duration = std::chrono::duration<double>(1.0 / frames_per_second);
+    while (not stop_requested) {
+        uint64_t sequence = shared.sequence.load(std::memory_order_acquire);
+        if (sequence != last_rendered_sequence) {
+            // NOTE: when no consistent copy could be made the frame is skipped and tried again on the next one
+            if (std::optional<Snapshot> snapshot = read_snapshot(shared)) {
+                render(shared, *snapshot);
+                last_rendered_sequence = sequence;
+            }
+        }
+        std::this_thread::sleep_for(frame_duration);
+    }
+
+    std::cout << "\033[2J\033[H\033[?25h";
+    std::cout.flush();
+    munmap(address, sizeof(SharedStateSnapshot));
+}